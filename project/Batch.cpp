@@ -0,0 +1,440 @@
+#include "Batch.hpp"
+#include "Document.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <dirent.h>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace svg {
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+//! Seconds elapsed since a given time
+double since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//! A file on its way through the pipeline; each stage fills in the next
+//! member and releases the previous one.
+struct Item {
+    size_t job;
+    std::vector<char> bytes;
+    std::unique_ptr<Document> doc;
+    std::unique_ptr<PNGImage> img;
+};
+
+//! Queue between two stages. push() blocks while the queue is full and
+//! pop() while it is empty; once closed by the producing stage, pop()
+//! returns false when nothing is left.
+class BoundedQueue {
+  public:
+    explicit BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(1, capacity)) {}
+
+    void push(std::unique_ptr<Item> item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+    }
+
+    bool pop(std::unique_ptr<Item> &item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return !items_.empty() || closed_; });
+        if (items_.empty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+  private:
+    size_t capacity_;
+    bool closed_ = false;
+    std::deque<std::unique_ptr<Item>> items_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_, not_full_;
+};
+
+//! Everything the stages share
+struct Pipeline {
+    const std::vector<BatchJob> &jobs;
+    BatchReport &report;
+    std::mutex mutex;
+
+    //! Records that a file failed, so that it skips the remaining stages
+    void fail(const Item &item, const std::exception &e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        report.errors.push_back(jobs[item.job].input + ": " + e.what());
+        report.failed.push_back(item.job);
+    }
+
+    //! Adds the time of one thread to its stage
+    void account(StageReport &stage, size_t items, double busy, double waiting) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stage.items += items;
+        stage.busy += busy;
+        stage.waiting += waiting;
+    }
+};
+
+//! Runs the threads of a stage that takes files from one queue, works on
+//! them and passes them on to the next queue (if any), which is closed once
+//! all the threads are done
+std::vector<std::thread> startStage(Pipeline &pipeline, StageReport &stage,
+                                    BoundedQueue &in, BoundedQueue *out,
+                                    std::function<void(Item &)> work) {
+    std::vector<std::thread> threads;
+    auto remaining = std::make_shared<std::atomic<unsigned>>(stage.threads);
+    for (unsigned t = 0; t < stage.threads; t++) {
+        threads.emplace_back([&pipeline, &stage, &in, out, work, remaining]() {
+            size_t items = 0;
+            double busy = 0, waiting = 0;
+            std::unique_ptr<Item> item;
+            for (;;) {
+                Clock::time_point start = Clock::now();
+                bool more = in.pop(item);
+                waiting += since(start);
+                if (!more) {
+                    break;
+                }
+                start = Clock::now();
+                bool ok = true;
+                try {
+                    work(*item);
+                } catch (const std::exception &e) {
+                    pipeline.fail(*item, e);
+                    ok = false;
+                }
+                busy += since(start);
+                items++;
+                if (ok && out != nullptr) {
+                    start = Clock::now();
+                    out->push(std::move(item));
+                    waiting += since(start);
+                }
+                item.reset();
+            }
+            pipeline.account(stage, items, busy, waiting);
+            if (--*remaining == 0 && out != nullptr) {
+                out->close();
+            }
+        });
+    }
+    return threads;
+}
+
+//! What the manifest records of one file
+struct ManifestEntry {
+    std::string hash;
+    std::string output;
+};
+
+//! The options that change the images, as recorded in the manifest
+std::string optionsKey(const std::string &extension,
+                       const BatchOptions &options) {
+    const char *formats[] = {"rgb", "rgbx", "rgba"};
+    return std::string("extension=") + extension +
+           " format=" + formats[(int)options.format];
+}
+
+//! 64-bit FNV-1a hash of a file's contents, in hexadecimal, or an empty
+//! string if the file cannot be read
+std::string hashFile(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return "";
+    }
+    uint64_t hash = 14695981039346656037ull;
+    char buffer[1 << 16];
+    while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0) {
+        const unsigned char *p = (const unsigned char *)buffer;
+        for (std::streamsize i = 0, n = in.gcount(); i < n; i++) {
+            hash = (hash ^ p[i]) * 1099511628211ull;
+        }
+    }
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    return hex;
+}
+
+//! Names of the SVG and SVGZ files of a directory, sorted
+std::vector<std::string> listInputs(const std::string &dir) {
+    ::DIR *directory = ::opendir(dir.c_str());
+    if (directory == nullptr) {
+        throw std::runtime_error("Unable to open directory " + dir);
+    }
+    std::vector<std::string> names;
+    ::dirent *entry;
+    while ((entry = ::readdir(directory)) != nullptr) {
+        std::string name = entry->d_name;
+        size_t dot = name.find_last_of('.');
+        std::string extension = dot == std::string::npos ? "" : name.substr(dot);
+        if (entry->d_type == DT_REG && (extension == ".svg" || extension == ".svgz")) {
+            names.push_back(name);
+        }
+    }
+    ::closedir(directory);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+//! Whether a manifest image name is one rebuild_directory could have
+//! written: a file of the output directory itself, with an image extension,
+//! so that a tampered manifest cannot make it remove anything else
+bool isImageName(const std::string &name) {
+    static const char *const extensions[] = {".png", ".ppm", ".qoi", ".raw"};
+    if (name.empty() || name[0] == '.' || name.find('/') != std::string::npos) {
+        return false;
+    }
+    for (const char *extension : extensions) {
+        size_t n = std::strlen(extension);
+        if (name.size() > n && name.compare(name.size() - n, n, extension) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//! Whether a file exists
+bool exists(const std::string &path) {
+    struct stat info;
+    return ::stat(path.c_str(), &info) == 0;
+}
+
+//! Reads a manifest: a header line, the options line, then one line per
+//! file with its hash, name and image name, separated by tabs. Returns
+//! false if there is none or it is not one.
+bool readManifest(const std::string &path, std::string &options,
+                  std::unordered_map<std::string, ManifestEntry> &entries) {
+    std::ifstream in(path);
+    std::string line;
+    if (!std::getline(in, line) || line != "svgtopng-manifest 1" ||
+        !std::getline(in, line) || line.compare(0, 8, "options ") != 0) {
+        return false;
+    }
+    options = line.substr(8);
+    while (std::getline(in, line)) {
+        size_t tab1 = line.find('\t');
+        size_t tab2 = line.find('\t', tab1 + 1);
+        if (tab1 == std::string::npos || tab2 == std::string::npos) {
+            return false;
+        }
+        entries[line.substr(tab1 + 1, tab2 - tab1 - 1)] = {line.substr(0, tab1),
+                                                            line.substr(tab2 + 1)};
+    }
+    return true;
+}
+
+//! Writes a manifest next to its final place, then moves it there, so that
+//! an interrupted rebuild leaves the previous one
+void writeManifest(const std::string &path, const std::string &options,
+                   const std::vector<std::pair<std::string, ManifestEntry>> &entries) {
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary);
+        out << "svgtopng-manifest 1\noptions " << options << "\n";
+        for (const auto &entry : entries) {
+            out << entry.second.hash << '\t' << entry.first << '\t'
+                << entry.second.output << '\n';
+        }
+        if (!out.flush()) {
+            throw std::runtime_error("Unable to write " + temporary);
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Unable to write " + path);
+    }
+}
+
+}   // namespace
+
+const char *const REBUILD_MANIFEST = ".svgtopng-manifest";
+
+RebuildReport rebuild_directory(const std::string &input_dir,
+                                const std::string &output_dir,
+                                const std::string &extension,
+                                const BatchOptions &options) {
+    std::vector<std::string> names = listInputs(input_dir);
+    if (!exists(output_dir) && ::mkdir(output_dir.c_str(), 0777) != 0) {
+        throw std::runtime_error("Unable to create directory " + output_dir);
+    }
+    std::string manifest = output_dir + "/" + REBUILD_MANIFEST;
+    std::string key = optionsKey(extension, options), old_key;
+    std::unordered_map<std::string, ManifestEntry> old;
+    if (!readManifest(manifest, old_key, old)) {
+        old.clear();
+    }
+
+    // Files whose hash, options and image are unchanged are kept as they
+    // are; the others are converted.
+    RebuildReport report;
+    std::vector<std::pair<std::string, ManifestEntry>> entries;
+    std::vector<BatchJob> jobs;
+    std::vector<size_t> job_entries;
+    std::unordered_map<std::string, std::string> outputs;
+    for (const std::string &name : names) {
+        ManifestEntry entry{"", name.substr(0, name.find_last_of('.')) + "." + extension};
+        auto taken = outputs.find(entry.output);
+        if (taken != outputs.end()) {
+            report.conflicts.push_back(input_dir + "/" + name + ": same image " +
+                                       entry.output + " as " + taken->second);
+            continue;
+        }
+        outputs[entry.output] = name;
+        entry.hash = hashFile(input_dir + "/" + name);
+        std::string output = output_dir + "/" + entry.output;
+        auto it = old.find(name);
+        if (old_key == key && it != old.end() && !entry.hash.empty() &&
+            it->second.hash == entry.hash && it->second.output == entry.output &&
+            exists(output)) {
+            report.unchanged++;
+        } else {
+            job_entries.push_back(entries.size());
+            jobs.push_back({input_dir + "/" + name, output});
+        }
+        entries.push_back({name, entry});
+    }
+
+    // Images of files that were removed, or renamed by a change of
+    // extension, are stale.
+    for (const auto &entry : old) {
+        if (outputs.count(entry.second.output) == 0 &&
+            isImageName(entry.second.output) &&
+            std::remove((output_dir + "/" + entry.second.output).c_str()) == 0) {
+            report.removed++;
+        }
+    }
+
+    report.batch = convert_batch(jobs, options);
+    std::vector<bool> keep(entries.size(), true);
+    for (size_t job : report.batch.failed) {
+        keep[job_entries[job]] = false;
+    }
+    std::vector<std::pair<std::string, ManifestEntry>> kept;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (keep[i]) {
+            kept.push_back(entries[i]);
+        }
+    }
+    writeManifest(manifest, key, kept);
+    return report;
+}
+
+BatchReport convert_batch(const std::vector<BatchJob> &jobs,
+                          const BatchOptions &options) {
+    Clock::time_point start = Clock::now();
+    BatchReport report;
+    unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    auto stage = [&report](const char *name, unsigned threads) {
+        report.stages.push_back(StageReport());
+        report.stages.back().name = name;
+        report.stages.back().threads = std::max(1u, threads);
+    };
+    stage("read", 1);
+    stage("parse", options.parse_threads);
+    stage("render", options.render_threads == 0 ? hardware : options.render_threads);
+    stage("encode", options.encode_threads);
+    Pipeline pipeline{jobs, report, {}};
+    BoundedQueue read(options.queue_capacity), parsed(options.queue_capacity),
+        rendered(options.queue_capacity);
+    PixelFormat format = options.format;
+    double timeout = options.timeout;
+
+    // The stages, back to front, so that each is waiting for input.
+    std::vector<std::thread> threads;
+    auto add = [&threads](std::vector<std::thread> stage) {
+        for (std::thread &t : stage) {
+            threads.push_back(std::move(t));
+        }
+    };
+    add(startStage(pipeline, report.stages[3], rendered, nullptr, [&](Item &item) {
+        item.img->save(jobs[item.job].output);
+    }));
+    add(startStage(pipeline, report.stages[2], parsed, &rendered, [format, timeout](Item &item) {
+        item.img.reset(new PNGImage(item.doc->width(), item.doc->height(), format));
+        CancelToken deadline;
+        if (timeout > 0) {
+            deadline.set_deadline(timeout);
+            item.img->set_cancel(&deadline);
+        }
+        item.doc->draw(*item.img);
+        item.img->set_cancel(nullptr);
+        item.doc.reset();
+    }));
+    add(startStage(pipeline, report.stages[1], read, &parsed, [&](Item &item) {
+        item.doc.reset(new Document(jobs[item.job].input, item.bytes.data(),
+                                    item.bytes.size(), options.limits));
+        std::vector<char>().swap(item.bytes);
+    }));
+
+    // Reading, one file after the other, so that the disk is read
+    // sequentially while the other stages compute.
+    std::thread reader([&]() {
+        StageReport &stage = report.stages[0];
+        size_t items = 0;
+        double busy = 0, waiting = 0;
+        for (size_t i = 0; i < jobs.size(); i++) {
+            Clock::time_point t = Clock::now();
+            std::unique_ptr<Item> item(new Item());
+            item->job = i;
+            try {
+                std::ifstream in(jobs[i].input, std::ios::binary);
+                in.seekg(0, std::ios::end);
+                std::streamoff size = in.tellg();
+                if (!in || size < 0) {
+                    throw std::runtime_error("Unable to load " + jobs[i].input);
+                }
+                item->bytes.resize((size_t)size);
+                in.seekg(0);
+                if (!in.read(item->bytes.data(), size)) {
+                    throw std::runtime_error("Unable to load " + jobs[i].input);
+                }
+            } catch (const std::exception &e) {
+                pipeline.fail(*item, e);
+                item.reset();
+            }
+            busy += since(t);
+            items++;
+            if (item != nullptr) {
+                t = Clock::now();
+                read.push(std::move(item));
+                waiting += since(t);
+            }
+        }
+        pipeline.account(stage, items, busy, waiting);
+        read.close();
+    });
+    reader.join();
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    report.converted = jobs.size() - report.errors.size();
+    report.seconds = since(start);
+    return report;
+}
+
+}   // namespace svg
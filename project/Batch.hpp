@@ -0,0 +1,119 @@
+//! @file Batch.hpp
+#ifndef __svg_Batch_hpp__
+#define __svg_Batch_hpp__
+
+#include "PNGImage.hpp"
+#include "SVGElements.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace svg {
+
+//! One file to convert in a batch.
+struct BatchJob {
+    //! Path of the SVG (or SVGZ) file to read.
+    std::string input;
+    //! Path of the image to write; its extension gives the file format.
+    std::string output;
+};
+
+//! Settings of a batch conversion.
+struct BatchOptions {
+    //! Files that may wait between two stages; bounds the memory used by
+    //! file contents, documents and images in flight.
+    size_t queue_capacity = 4;
+    //! Threads parsing files.
+    unsigned parse_threads = 1;
+    //! Threads drawing documents; 0 uses one per hardware thread.
+    unsigned render_threads = 0;
+    //! Threads encoding and writing images.
+    unsigned encode_threads = 1;
+    //! Layout of the canvases.
+    PixelFormat format = PixelFormat::rgb;
+    //! Bounds on each document; a file exceeding one fails to parse.
+    Limits limits;
+    //! Seconds a file may take to draw before it is given up; 0 for no limit.
+    double timeout = 0;
+};
+
+//! Time spent by one stage of a batch conversion, summed over its threads.
+struct StageReport {
+    //! Stage name: read, parse, render or encode.
+    std::string name;
+    //! Number of threads of the stage.
+    unsigned threads = 0;
+    //! Files that went through the stage.
+    size_t items = 0;
+    //! Seconds spent working on files.
+    double busy = 0;
+    //! Seconds spent waiting for input or for room in the next queue.
+    double waiting = 0;
+};
+
+//! Outcome of a batch conversion.
+struct BatchReport {
+    //! The four stages, in pipeline order.
+    std::vector<StageReport> stages;
+    //! Files converted.
+    size_t converted = 0;
+    //! One message per file that could not be converted.
+    std::vector<std::string> errors;
+    //! Index in the jobs of each file that could not be converted, in the
+    //! order of the errors.
+    std::vector<size_t> failed;
+    //! Seconds from start to end of the batch.
+    double seconds = 0;
+};
+
+//! Converts many files with a pipeline of stages connected by bounded
+//! queues: reading files into memory, parsing them, drawing them and
+//! encoding and writing the images. Each stage has its own threads, so that
+//! one file is read while others are parsed, drawn or written, and disk I/O
+//! overlaps computation. Files may finish in any order; a file that fails
+//! in a stage is reported and skips the remaining stages.
+//! @param jobs The files to convert.
+//! @param options Queue capacity, threads per stage, pixel format, limits
+//! and timeout.
+//! @return Per-stage timings and the errors.
+BatchReport convert_batch(const std::vector<BatchJob> &jobs,
+                          const BatchOptions &options = BatchOptions());
+
+//! Outcome of a directory rebuild.
+struct RebuildReport {
+    //! Conversion of the files that changed.
+    BatchReport batch;
+    //! Files whose image was up to date.
+    size_t unchanged = 0;
+    //! Images removed because their file is gone.
+    size_t removed = 0;
+    //! One message per file left out because its image would have the name
+    //! of the image of another file (such as a.svg and a.svgz).
+    std::vector<std::string> conflicts;
+};
+
+//! Name of the manifest kept by rebuild_directory in the output directory.
+extern const char *const REBUILD_MANIFEST;
+
+//! Brings a directory of images up to date with a directory of SVG (and
+//! SVGZ) files. A manifest in the output directory records the content hash
+//! of each file and the options of the images; only files whose hash or
+//! options changed, or whose image is missing, are converted, through
+//! convert_batch. Images of files that are no longer there are removed,
+//! provided their manifest name is a plain image name in the output
+//! directory. Of two files with the same image name, the first is converted
+//! and the other reported as a conflict. Files that fail or conflict are
+//! left out of the manifest, so they are tried again.
+//! Subdirectories are not visited.
+//! @param input_dir Directory of the SVG files.
+//! @param output_dir Directory of the images, created if needed.
+//! @param extension Extension, and so file format, of the images.
+//! @param options Settings of the conversion of the files that changed.
+//! @return The batch report, and how many files were skipped or removed.
+RebuildReport rebuild_directory(const std::string &input_dir,
+                                const std::string &output_dir,
+                                const std::string &extension,
+                                const BatchOptions &options = BatchOptions());
+
+}   // namespace svg
+#endif
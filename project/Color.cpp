@@ -1,34 +1,372 @@
 #include "Color.hpp"
-#include <map>
-#include <iomanip>
-#include <sstream>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
 
 namespace svg
 {
-    const std::map<std::string, Color> NAMES_TO_COLORS = {
-        {"black", {0, 0, 0}},
-        {"white", {255, 255, 255}},
-        {"red", {255, 0, 0}},
-        {"green", {0, 255, 0}},
-        {"blue", {0, 0, 255}},
-        {"yellow", {255, 255, 0}}};
+    namespace
+    {
+        struct NamedColor
+        {
+            const char *name;
+            Color color;
+        };
 
-    Color parse_color(const std::string &str)
+        //! SVG color keywords, in alphabetical order. As in earlier versions
+        //! of this project, "green" is {0, 255, 0} (SVG's "lime") rather
+        //! than SVG's {0, 128, 0}.
+        constexpr NamedColor NAMED_COLORS[] = {
+            {"aliceblue", {240, 248, 255}},
+            {"antiquewhite", {250, 235, 215}},
+            {"aqua", {0, 255, 255}},
+            {"aquamarine", {127, 255, 212}},
+            {"azure", {240, 255, 255}},
+            {"beige", {245, 245, 220}},
+            {"bisque", {255, 228, 196}},
+            {"black", {0, 0, 0}},
+            {"blanchedalmond", {255, 235, 205}},
+            {"blue", {0, 0, 255}},
+            {"blueviolet", {138, 43, 226}},
+            {"brown", {165, 42, 42}},
+            {"burlywood", {222, 184, 135}},
+            {"cadetblue", {95, 158, 160}},
+            {"chartreuse", {127, 255, 0}},
+            {"chocolate", {210, 105, 30}},
+            {"coral", {255, 127, 80}},
+            {"cornflowerblue", {100, 149, 237}},
+            {"cornsilk", {255, 248, 220}},
+            {"crimson", {220, 20, 60}},
+            {"cyan", {0, 255, 255}},
+            {"darkblue", {0, 0, 139}},
+            {"darkcyan", {0, 139, 139}},
+            {"darkgoldenrod", {184, 134, 11}},
+            {"darkgray", {169, 169, 169}},
+            {"darkgreen", {0, 100, 0}},
+            {"darkgrey", {169, 169, 169}},
+            {"darkkhaki", {189, 183, 107}},
+            {"darkmagenta", {139, 0, 139}},
+            {"darkolivegreen", {85, 107, 47}},
+            {"darkorange", {255, 140, 0}},
+            {"darkorchid", {153, 50, 204}},
+            {"darkred", {139, 0, 0}},
+            {"darksalmon", {233, 150, 122}},
+            {"darkseagreen", {143, 188, 143}},
+            {"darkslateblue", {72, 61, 139}},
+            {"darkslategray", {47, 79, 79}},
+            {"darkslategrey", {47, 79, 79}},
+            {"darkturquoise", {0, 206, 209}},
+            {"darkviolet", {148, 0, 211}},
+            {"deeppink", {255, 20, 147}},
+            {"deepskyblue", {0, 191, 255}},
+            {"dimgray", {105, 105, 105}},
+            {"dimgrey", {105, 105, 105}},
+            {"dodgerblue", {30, 144, 255}},
+            {"firebrick", {178, 34, 34}},
+            {"floralwhite", {255, 250, 240}},
+            {"forestgreen", {34, 139, 34}},
+            {"fuchsia", {255, 0, 255}},
+            {"gainsboro", {220, 220, 220}},
+            {"ghostwhite", {248, 248, 255}},
+            {"gold", {255, 215, 0}},
+            {"goldenrod", {218, 165, 32}},
+            {"gray", {128, 128, 128}},
+            {"grey", {128, 128, 128}},
+            {"green", {0, 255, 0}},
+            {"greenyellow", {173, 255, 47}},
+            {"honeydew", {240, 255, 240}},
+            {"hotpink", {255, 105, 180}},
+            {"indianred", {205, 92, 92}},
+            {"indigo", {75, 0, 130}},
+            {"ivory", {255, 255, 240}},
+            {"khaki", {240, 230, 140}},
+            {"lavender", {230, 230, 250}},
+            {"lavenderblush", {255, 240, 245}},
+            {"lawngreen", {124, 252, 0}},
+            {"lemonchiffon", {255, 250, 205}},
+            {"lightblue", {173, 216, 230}},
+            {"lightcoral", {240, 128, 128}},
+            {"lightcyan", {224, 255, 255}},
+            {"lightgoldenrodyellow", {250, 250, 210}},
+            {"lightgray", {211, 211, 211}},
+            {"lightgreen", {144, 238, 144}},
+            {"lightgrey", {211, 211, 211}},
+            {"lightpink", {255, 182, 193}},
+            {"lightsalmon", {255, 160, 122}},
+            {"lightseagreen", {32, 178, 170}},
+            {"lightskyblue", {135, 206, 250}},
+            {"lightslategray", {119, 136, 153}},
+            {"lightslategrey", {119, 136, 153}},
+            {"lightsteelblue", {176, 196, 222}},
+            {"lightyellow", {255, 255, 224}},
+            {"lime", {0, 255, 0}},
+            {"limegreen", {50, 205, 50}},
+            {"linen", {250, 240, 230}},
+            {"magenta", {255, 0, 255}},
+            {"maroon", {128, 0, 0}},
+            {"mediumaquamarine", {102, 205, 170}},
+            {"mediumblue", {0, 0, 205}},
+            {"mediumorchid", {186, 85, 211}},
+            {"mediumpurple", {147, 112, 219}},
+            {"mediumseagreen", {60, 179, 113}},
+            {"mediumslateblue", {123, 104, 238}},
+            {"mediumspringgreen", {0, 250, 154}},
+            {"mediumturquoise", {72, 209, 204}},
+            {"mediumvioletred", {199, 21, 133}},
+            {"midnightblue", {25, 25, 112}},
+            {"mintcream", {245, 255, 250}},
+            {"mistyrose", {255, 228, 225}},
+            {"moccasin", {255, 228, 181}},
+            {"navajowhite", {255, 222, 173}},
+            {"navy", {0, 0, 128}},
+            {"oldlace", {253, 245, 230}},
+            {"olive", {128, 128, 0}},
+            {"olivedrab", {107, 142, 35}},
+            {"orange", {255, 165, 0}},
+            {"orangered", {255, 69, 0}},
+            {"orchid", {218, 112, 214}},
+            {"palegoldenrod", {238, 232, 170}},
+            {"palegreen", {152, 251, 152}},
+            {"paleturquoise", {175, 238, 238}},
+            {"palevioletred", {219, 112, 147}},
+            {"papayawhip", {255, 239, 213}},
+            {"peachpuff", {255, 218, 185}},
+            {"peru", {205, 133, 63}},
+            {"pink", {255, 192, 203}},
+            {"plum", {221, 160, 221}},
+            {"powderblue", {176, 224, 230}},
+            {"purple", {128, 0, 128}},
+            {"red", {255, 0, 0}},
+            {"rosybrown", {188, 143, 143}},
+            {"royalblue", {65, 105, 225}},
+            {"saddlebrown", {139, 69, 19}},
+            {"salmon", {250, 128, 114}},
+            {"sandybrown", {244, 164, 96}},
+            {"seagreen", {46, 139, 87}},
+            {"seashell", {255, 245, 238}},
+            {"sienna", {160, 82, 45}},
+            {"silver", {192, 192, 192}},
+            {"skyblue", {135, 206, 235}},
+            {"slateblue", {106, 90, 205}},
+            {"slategray", {112, 128, 144}},
+            {"slategrey", {112, 128, 144}},
+            {"snow", {255, 250, 250}},
+            {"springgreen", {0, 255, 127}},
+            {"steelblue", {70, 130, 180}},
+            {"tan", {210, 180, 140}},
+            {"teal", {0, 128, 128}},
+            {"thistle", {216, 191, 216}},
+            {"tomato", {255, 99, 71}},
+            {"turquoise", {64, 224, 208}},
+            {"violet", {238, 130, 238}},
+            {"wheat", {245, 222, 179}},
+            {"white", {255, 255, 255}},
+            {"whitesmoke", {245, 245, 245}},
+            {"yellow", {255, 255, 0}},
+            {"yellowgreen", {154, 205, 50}}
+        };
+        constexpr size_t NAMED_COLOR_COUNT = sizeof(NAMED_COLORS) / sizeof(NAMED_COLORS[0]);
+        //! Length of "lightgoldenrodyellow", the longest keyword.
+        constexpr size_t MAX_NAME_LENGTH = 20;
+
+        // Keywords are found with a two-level (hash and displace) perfect
+        // hash: the low bits of the name's hash pick a displacement, and
+        // the displaced hash picks one of 256 slots, no two keywords
+        // sharing a slot. The tables are checked by the static_assert below.
+        //! Displacement applied to the hash of each bucket (hash & 63).
+        constexpr uint8_t DISPLACEMENTS[64] = {
+            0, 0, 0, 0, 1, 0, 2, 0, 1, 2, 2, 0, 2, 0, 3, 0,
+            2, 1, 1, 2, 0, 1, 0, 6, 1, 0, 0, 0, 1, 4, 3, 4,
+            1, 0, 0, 0, 0, 0, 0, 1, 3, 1, 4, 0, 0, 4, 2, 1,
+            0, 2, 8, 0, 4, 1, 3, 2, 0, 1, 0, 13, 0, 3, 4, 0
+        };
+
+        //! Index + 1 in NAMED_COLORS of the keyword stored in each slot, 0 if none.
+        constexpr uint8_t SLOTS[256] = {
+            0, 61, 0, 0, 29, 92, 0, 0, 129, 0, 0, 0, 0, 74, 0, 142,
+            0, 77, 121, 0, 0, 59, 96, 32, 18, 80, 82, 0, 0, 0, 56, 76,
+            136, 23, 0, 72, 0, 137, 46, 85, 0, 0, 139, 0, 0, 19, 89, 27,
+            20, 48, 40, 1, 0, 83, 15, 0, 128, 0, 6, 33, 28, 57, 98, 52,
+            0, 60, 0, 7, 0, 124, 0, 0, 0, 134, 106, 36, 0, 0, 70, 118,
+            13, 4, 0, 0, 0, 88, 0, 0, 145, 0, 0, 0, 66, 146, 0, 64,
+            0, 25, 0, 91, 50, 0, 0, 0, 0, 16, 0, 93, 0, 0, 107, 0,
+            21, 112, 100, 2, 0, 0, 0, 0, 0, 0, 102, 0, 0, 101, 55, 122,
+            78, 117, 0, 108, 0, 41, 0, 0, 22, 39, 0, 43, 86, 0, 0, 0,
+            81, 90, 51, 125, 49, 144, 94, 0, 14, 58, 147, 0, 69, 135, 0, 38,
+            0, 0, 0, 0, 0, 0, 99, 141, 0, 97, 0, 68, 0, 42, 0, 54,
+            34, 140, 84, 26, 47, 35, 138, 9, 0, 0, 12, 65, 44, 133, 0, 0,
+            45, 73, 105, 0, 110, 116, 24, 120, 130, 0, 95, 0, 67, 87, 37, 71,
+            53, 0, 119, 104, 0, 3, 126, 10, 0, 0, 131, 115, 0, 0, 31, 0,
+            143, 127, 0, 30, 114, 0, 0, 0, 75, 111, 109, 0, 0, 0, 103, 63,
+            11, 8, 132, 17, 79, 5, 0, 0, 0, 0, 62, 0, 123, 113, 0, 0
+        };
+
+        constexpr char lower(char c)
+        {
+            return c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+        }
+
+        //! Case-insensitive FNV-1a hash (compile-time version).
+        constexpr uint32_t hash_name(const char *s, uint32_t h = 2166136261u)
+        {
+            return *s == '\0' ? h : hash_name(s + 1, (h ^ (uint8_t)lower(*s)) * 16777619u);
+        }
+
+        constexpr uint32_t slot_of(uint32_t h)
+        {
+            return ((h ^ (DISPLACEMENTS[h & 63] * 2654435761u)) * 2246822519u) >> 24;
+        }
+
+        constexpr bool slots_match(size_t from, size_t to)
+        {
+            return to - from == 1
+                       ? SLOTS[slot_of(hash_name(NAMED_COLORS[from].name))] == from + 1
+                       : slots_match(from, (from + to) / 2) && slots_match((from + to) / 2, to);
+        }
+        static_assert(slots_match(0, NAMED_COLOR_COUNT),
+                      "SLOTS is not a perfect hash of NAMED_COLORS");
+
+        bool is_space(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        }
+
+        int hex_digit(char c)
+        {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+            return -1;
+        }
+
+        //! Parses '#rgb' or '#rrggbb' digits in [s, e).
+        bool parse_hex(const char *s, const char *e, Color &c)
+        {
+            int d[6];
+            size_t n = e - s;
+            if (n != 3 && n != 6)
+                return false;
+            for (size_t i = 0; i < n; i++)
+            {
+                if ((d[i] = hex_digit(s[i])) < 0)
+                    return false;
+            }
+            if (n == 3)
+            {
+                c = {(rgb_value)(d[0] * 17), (rgb_value)(d[1] * 17), (rgb_value)(d[2] * 17)};
+            }
+            else
+            {
+                c = {(rgb_value)(d[0] * 16 + d[1]), (rgb_value)(d[2] * 16 + d[3]),
+                     (rgb_value)(d[4] * 16 + d[5])};
+            }
+            return true;
+        }
+
+        //! Parses the arguments of 'rgb(r, g, b)' in [s, e), where each
+        //! component is a number in 0-255 or a percentage.
+        bool parse_rgb_function(const char *s, const char *e, Color &c)
+        {
+            rgb_value *components[3] = {&c.red, &c.green, &c.blue};
+            for (int i = 0; i < 3; i++)
+            {
+                while (s < e && is_space(*s))
+                    s++;
+                char *end;
+                double v = ::strtod(s, &end);
+                // strtod also reads "nan", "inf" and overflows to infinity,
+                // which cannot be rounded to a component.
+                if (end == s || end > e || !std::isfinite(v))
+                    return false;
+                s = end;
+                if (s < e && *s == '%')
+                {
+                    v = v * 255.0 / 100.0;
+                    s++;
+                }
+                v = v < 0 ? 0 : (v > 255 ? 255 : v);
+                *components[i] = (rgb_value)(v + 0.5);
+                while (s < e && is_space(*s))
+                    s++;
+                if (i < 2)
+                {
+                    if (s == e || *s != ',')
+                        return false;
+                    s++;
+                }
+            }
+            return s == e;
+        }
+
+        //! Looks a keyword up in [s, e).
+        const NamedColor *find_name(const char *s, const char *e)
+        {
+            size_t n = e - s;
+            if (n == 0 || n > MAX_NAME_LENGTH)
+                return nullptr;
+            uint32_t h = 2166136261u;
+            for (const char *p = s; p < e; p++)
+            {
+                h = (h ^ (uint8_t)lower(*p)) * 16777619u;
+            }
+            uint8_t index = SLOTS[slot_of(h)];
+            if (index == 0)
+                return nullptr;
+            const NamedColor &candidate = NAMED_COLORS[index - 1];
+            for (size_t i = 0; i < n; i++)
+            {
+                if (candidate.name[i] != lower(s[i]))
+                    return nullptr;
+            }
+            return candidate.name[n] == '\0' ? &candidate : nullptr;
+        }
+    }
+
+    Color parse_color(const char *str)
     {
-        Color c;
-        if (str.at(0) == '#')
+        if (str == nullptr)
         {
-            int v;
-            std::istringstream ss(str.substr(1));
-            ss >> std::hex >> v;
-            c.red = (v >> 16);
-            c.green = (v >> 8) & 0xFF;
-            c.blue = v & 0xFF;
+            throw std::runtime_error("Missing color");
+        }
+        const char *s = str, *e = str;
+        while (*e != '\0')
+            e++;
+        while (s < e && is_space(*s))
+            s++;
+        while (e > s && is_space(e[-1]))
+            e--;
+
+        Color c = {0, 0, 0};
+        bool ok;
+        if (s < e && *s == '#')
+        {
+            ok = parse_hex(s + 1, e, c);
+        }
+        else if (e - s > 4 && (s[0] | 0x20) == 'r' && (s[1] | 0x20) == 'g' &&
+                 (s[2] | 0x20) == 'b' && s[3] == '(' && e[-1] == ')')
+        {
+            ok = parse_rgb_function(s + 4, e - 1, c);
         }
         else
         {
-            c = NAMES_TO_COLORS.at(str);
+            const NamedColor *named = find_name(s, e);
+            ok = named != nullptr;
+            if (ok)
+                c = named->color;
+        }
+        if (!ok)
+        {
+            throw std::runtime_error(std::string("Invalid color: ") + str);
         }
         return c;
     }
-}
\ No newline at end of file
+
+    Color parse_color(const std::string &str)
+    {
+        return parse_color(str.c_str());
+    }
+}
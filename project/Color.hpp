@@ -18,11 +18,20 @@ struct Color {
 };
 
 //! Parse a color from a string.
-//! The string may refer to a color name or have a
-//! '#rrggbb' format where 'rr', 'gg' and 'bb'
-//! are hexadecimal values for each RGB component.
+//! The string may be one of the 147 SVG color keywords (case-insensitive),
+//! have a '#rrggbb' or '#rgb' format where 'rr', 'gg' and 'bb' (or 'r',
+//! 'g' and 'b') are hexadecimal values for each RGB component, or be
+//! 'rgb(r, g, b)' with decimal or percentage components.
+//! Parsing does not allocate memory unless the color is invalid.
 //! @param str String.
 //! @return A corresponding color.
+//! @throws std::runtime_error if the string is not a valid color.
+Color parse_color(const char *str);
+
+//! Parse a color from a string.
+//! @param str String.
+//! @return A corresponding color.
+//! @see parse_color(const char *)
 Color parse_color(const std::string &str);
 
 }   // namespace svg
@@ -0,0 +1,83 @@
+#include "Document.hpp"
+
+namespace svg {
+
+//! Constructor for the Document class.
+Document::Document(const std::string &svg_file, const Limits &limits) {
+    readSVG(svg_file, dimensions_, elements_, dictionary_, limits);
+    build_index();
+}
+
+//! Constructor for the Document class, from memory.
+Document::Document(const std::string &name, const char *data, size_t size,
+                   const Limits &limits) {
+    readSVG(data, size, name, dimensions_, elements_, dictionary_, limits);
+    build_index();
+}
+
+//! Build index function for the Document class.
+void Document::build_index() {
+    // Shapes inside groups are indexed one by one, so that a document
+    // wrapped in a group is still culled.
+    for (const SVGElement *e : elements_) {
+        e->parts(parts_);
+    }
+    std::vector<Box> bounds;
+    bounds.reserve(parts_.size());
+    for (const SVGElement *e : parts_) {
+        bounds.push_back(e->bounds());
+    }
+    index_ = SpatialIndex(bounds);
+}
+
+//! Move constructor for the Document class.
+Document::Document(Document &&other)
+    : dimensions_(other.dimensions_), elements_(std::move(other.elements_)),
+      dictionary_(std::move(other.dictionary_)),
+      parts_(std::move(other.parts_)), index_(std::move(other.index_)) {
+    other.elements_.clear();
+    other.dictionary_.clear();
+    other.parts_.clear();
+}
+
+//! Destructor for the Document class.
+Document::~Document() {
+    for (SVGElement *e : elements_) {
+        delete e;
+    }
+}
+
+int Document::width() const { return dimensions_.x; }
+
+int Document::height() const { return dimensions_.y; }
+
+size_t Document::size() const { return elements_.size(); }
+
+const SVGElement &Document::element(size_t i) const { return *elements_.at(i); }
+
+const SVGElement *Document::find(const std::string &id) const {
+    auto it = dictionary_.find(id);
+    return it == dictionary_.end() ? nullptr : it->second;
+}
+
+//! Draw function for the Document class.
+void Document::draw(PNGImage &img) const {
+    for (const SVGElement *e : elements_) {
+        img.check_cancel();
+        e->draw(img);
+    }
+}
+
+//! Render region function for the Document class.
+void Document::render_region(int x, int y, PNGImage &img) const {
+    Box region = {x, y, x + img.width() - 1, y + img.height() - 1};
+    std::vector<size_t> hits;
+    index_.query(region, hits);
+    img.set_origin(x, y);
+    for (size_t i : hits) {
+        img.check_cancel();
+        parts_[i]->draw(img);
+    }
+    img.set_origin(0, 0);
+}
+}   // namespace svg
@@ -0,0 +1,98 @@
+//! @file Document.hpp
+#ifndef __svg_Document_hpp__
+#define __svg_Document_hpp__
+
+#include "PNGImage.hpp"
+#include "Point.hpp"
+#include "SVGElements.hpp"
+#include "SpatialIndex.hpp"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace svg {
+
+//! @class Document
+//! A parsed SVG document. The document owns its elements, dimensions and
+//! id dictionary, and is never modified after construction, so a single
+//! instance may be kept in memory and drawn repeatedly, including from
+//! several threads at once as long as each thread draws into its own image.
+class Document {
+  public:
+    //! Parses an SVG file.
+    //! @param svg_file The path to the SVG file.
+    //! @param limits Bounds on the document; exceeding one throws.
+    explicit Document(const std::string &svg_file,
+                      const Limits &limits = Limits());
+
+    //! Parses an SVG file already read into memory, plain or
+    //! gzip-compressed.
+    //! @param name The file name, for error messages.
+    //! @param data The file contents.
+    //! @param size The size of the file contents, in bytes.
+    //! @param limits Bounds on the document; exceeding one throws.
+    Document(const std::string &name, const char *data, size_t size,
+             const Limits &limits = Limits());
+
+    //! Move constructor; the moved-from document becomes empty.
+    //! @param other The document to take ownership from.
+    Document(Document &&other);
+
+    //! Destructor, releases all elements.
+    ~Document();
+
+    Document(const Document &) = delete;
+    Document &operator=(const Document &) = delete;
+
+    //! Get the document width.
+    //! @return The width declared by the root element.
+    int width() const;
+
+    //! Get the document height.
+    //! @return The height declared by the root element.
+    int height() const;
+
+    //! Get the number of top-level elements.
+    //! @return The number of top-level elements.
+    size_t size() const;
+
+    //! Get a top-level element.
+    //! @param i Element index, in document order.
+    //! @return The element.
+    const SVGElement &element(size_t i) const;
+
+    //! Looks up an element by its id attribute.
+    //! @param id The element id.
+    //! @return The element, or nullptr if no element has that id.
+    const SVGElement *find(const std::string &id) const;
+
+    //! Draws all elements, in document order, on the given image.
+    //! @param img The PNG image to draw on.
+    void draw(PNGImage &img) const;
+
+    //! Draws a region of the document on an image of the region's size.
+    //! Only elements whose bounds intersect the region are drawn; they are
+    //! found through a spatial index built when the document is parsed.
+    //! @param x X coordinate of the region's top-left corner.
+    //! @param y Y coordinate of the region's top-left corner.
+    //! @param img The PNG image to draw on; its size is the region size.
+    void render_region(int x, int y, PNGImage &img) const;
+
+  private:
+    //! Builds the spatial index once the elements are parsed.
+    void build_index();
+
+    //! Width and height of the document.
+    Point dimensions_;
+    //! Top-level elements, in document order.
+    std::vector<SVGElement *> elements_;
+    //! Elements by id (including nested ones), owned through elements_.
+    std::unordered_map<std::string, SVGElement *> dictionary_;
+    //! Parts of the top-level elements that draw independently, in
+    //! drawing order, owned through elements_.
+    std::vector<const SVGElement *> parts_;
+    //! Bounds of the parts.
+    SpatialIndex index_;
+};
+}   // namespace svg
+#endif
@@ -0,0 +1,241 @@
+//! @file Gradient.cpp
+#include "Gradient.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace svg
+{
+    Gradient::Gradient(GradientKind kind, GradientUnits units, SpreadMethod spread,
+                       const std::vector<Point> &points, const std::vector<GradientStop> &stops)
+        : kind_(kind), units_(units), spread_(spread), points_(points), stops_(stops),
+          opaque_(!stops.empty()), lut_(LUT_SIZE * 4, 0)
+    {
+        for (const GradientStop &stop : stops)
+        {
+            opaque_ = opaque_ && stop.opacity >= 1;
+        }
+        if (stops.empty())
+        {
+            return;
+        }
+        // Colors are interpolated before being premultiplied, as in SVG.
+        size_t k = 0;
+        for (int i = 0; i < LUT_SIZE; i++)
+        {
+            double t = (double)i / (LUT_SIZE - 1);
+            while (k < stops.size() && stops[k].offset <= t)
+            {
+                k++;
+            }
+            const GradientStop &a = stops[k == 0 ? 0 : k - 1];
+            const GradientStop &b = stops[k == stops.size() ? k - 1 : k];
+            double f = b.offset > a.offset ? (t - a.offset) / (b.offset - a.offset) : 0;
+            f = std::max(0.0, std::min(1.0, f));
+            double opacity = a.opacity + (b.opacity - a.opacity) * f;
+            opacity = std::max(0.0, std::min(1.0, opacity));
+            unsigned char *p = &lut_[i * 4];
+            p[0] = (unsigned char)::lround((a.color.red + (b.color.red - a.color.red) * f) * opacity);
+            p[1] = (unsigned char)::lround((a.color.green + (b.color.green - a.color.green) * f) * opacity);
+            p[2] = (unsigned char)::lround((a.color.blue + (b.color.blue - a.color.blue) * f) * opacity);
+            p[3] = (unsigned char)::lround(255 * opacity);
+        }
+    }
+
+    GradientUnits Gradient::units() const
+    {
+        return units_;
+    }
+
+    bool Gradient::opaque() const
+    {
+        return opaque_;
+    }
+
+    const std::vector<Point> &Gradient::points() const
+    {
+        return points_;
+    }
+
+    const std::vector<GradientStop> &Gradient::stops() const
+    {
+        return stops_;
+    }
+
+    void Gradient::set_points(const std::vector<Point> &points)
+    {
+        points_ = points;
+    }
+
+    int Gradient::entry(double t) const
+    {
+        if (spread_ == SpreadMethod::repeat)
+        {
+            t -= std::floor(t);
+        }
+        else if (spread_ == SpreadMethod::reflect)
+        {
+            t = std::fabs(t);
+            t -= 2 * std::floor(t / 2);
+            if (t > 1)
+            {
+                t = 2 - t;
+            }
+        }
+        // Written so that NaN maps to 0.
+        t = t > 0 ? std::min(t, 1.0) : 0;
+        return (int)(t * (LUT_SIZE - 1) + 0.5) * 4;
+    }
+
+    void Gradient::shade_end(int n, unsigned char *out) const
+    {
+        const unsigned char *last = &lut_[(LUT_SIZE - 1) * 4];
+        for (int i = 0; i < n; i++)
+        {
+            ::memcpy(out + 4 * i, last, 4);
+        }
+    }
+
+    void Gradient::shade(int x, int y, int n, const Point &box_min, const Point &box_max,
+                         unsigned char *out) const
+    {
+        // Gradient coordinates are u = u0 + px du along the row, and v.
+        // Every pixel is shaded from its own position rather than by
+        // stepping from the start of the span, so that a span gives the
+        // same colors however it is clipped.
+        double u0 = 0, v = y, du = 1;
+        if (units_ == GradientUnits::bounding_box)
+        {
+            double w = box_max.x - box_min.x, h = box_max.y - box_min.y;
+            if (!(w > 0 && h > 0))
+            {
+                shade_end(n, out);
+                return;
+            }
+            u0 = -box_min.x / w;
+            v = (y - box_min.y) / h;
+            du = 1 / w;
+        }
+        const unsigned char *lut = lut_.data();
+
+        if (kind_ == GradientKind::linear)
+        {
+            const Point &a = points_[0], &b = points_[1];
+            double dx = b.x - a.x, dy = b.y - a.y, len2 = dx * dx + dy * dy;
+            if (!(len2 > 0))
+            {
+                shade_end(n, out);
+                return;
+            }
+            // The parameter is the projection on the gradient vector, an
+            // affine function t0 + px dt of the pixel.
+            double t0 = ((u0 - a.x) * dx + (v - a.y) * dy) / len2;
+            double dt = du * dx / len2;
+            int i = 0;
+#if defined(__SSE2__)
+            if (spread_ == SpreadMethod::pad)
+            {
+                // Four table positions at a time, clamped to the table;
+                // NaN becomes 0 as _mm_max_pd returns its second operand.
+                const __m128d base = _mm_set1_pd(t0 * (LUT_SIZE - 1) + 0.5);
+                const __m128d step = _mm_set1_pd(dt * (LUT_SIZE - 1));
+                const __m128d zero = _mm_setzero_pd();
+                const __m128d last = _mm_set1_pd(LUT_SIZE - 1);
+                const __m128d two = _mm_set1_pd(2);
+                __m128d px = _mm_set_pd(x + 1, x);
+                alignas(16) int index[4];
+                for (; i + 4 <= n; i += 4)
+                {
+                    __m128d s0 = _mm_add_pd(base, _mm_mul_pd(px, step));
+                    px = _mm_add_pd(px, two);
+                    __m128d s1 = _mm_add_pd(base, _mm_mul_pd(px, step));
+                    px = _mm_add_pd(px, two);
+                    s0 = _mm_min_pd(_mm_max_pd(s0, zero), last);
+                    s1 = _mm_min_pd(_mm_max_pd(s1, zero), last);
+                    _mm_storel_epi64((__m128i *)index, _mm_cvttpd_epi32(s0));
+                    _mm_storel_epi64((__m128i *)(index + 2), _mm_cvttpd_epi32(s1));
+                    for (int k = 0; k < 4; k++)
+                    {
+                        ::memcpy(out + 4 * (i + k), lut + 4 * index[k], 4);
+                    }
+                }
+            }
+#endif
+            for (; i < n; i++)
+            {
+                ::memcpy(out + 4 * i, lut + entry(t0 + (double)(x + i) * dt), 4);
+            }
+            return;
+        }
+
+        const Point &c = points_[0], &f = points_[1];
+        double rx = points_[2].x - c.x, ry = points_[2].y - c.y;
+        double r2 = rx * rx + ry * ry;
+        if (!(r2 > 0))
+        {
+            shade_end(n, out);
+            return;
+        }
+        // e goes from the focal point to the center; a focal point on or
+        // outside the circle is moved just inside it.
+        double ex = c.x - f.x, ey = c.y - f.y, e2 = ex * ex + ey * ey;
+        if (e2 > 0.99 * 0.99 * r2)
+        {
+            double k = 0.99 * std::sqrt(r2 / e2);
+            ex *= k;
+            ey *= k;
+            e2 = ex * ex + ey * ey;
+        }
+        // Circle t is centered at focal + t e with radius t r, so the pixel
+        // at d from the focal point is on it when |d - t e| = t r, i.e.
+        // t = |d|^2 / (d.e + sqrt((d.e)^2 + |d|^2 (r^2 - |e|^2))).
+        // d.x is dx0 + px du.
+        double dx0 = u0 - (c.x - ex), dy = v - (c.y - ey);
+        double dy2 = dy * dy, dey = dy * ey, k = r2 - e2;
+        int i = 0;
+#if defined(__SSE2__)
+        if (spread_ == SpreadMethod::pad)
+        {
+            // Two pixels at a time, in double precision since d.e and the
+            // root nearly cancel out behind the focal point.
+            const __m128d zero = _mm_setzero_pd();
+            const __m128d last = _mm_set1_pd(LUT_SIZE - 1);
+            const __m128d half = _mm_set1_pd(0.5);
+            const __m128d kk = _mm_set1_pd(k), yy = _mm_set1_pd(dy2);
+            const __m128d x0 = _mm_set1_pd(dx0), step = _mm_set1_pd(du);
+            const __m128d eex = _mm_set1_pd(ex), eey = _mm_set1_pd(dey);
+            const __m128d two = _mm_set1_pd(2);
+            __m128d px = _mm_set_pd(x + 1, x);
+            alignas(16) int index[4];
+            for (; i + 2 <= n; i += 2)
+            {
+                __m128d xx = _mm_add_pd(x0, _mm_mul_pd(px, step));
+                __m128d d_e = _mm_add_pd(_mm_mul_pd(xx, eex), eey);
+                __m128d d2 = _mm_add_pd(_mm_mul_pd(xx, xx), yy);
+                __m128d den = _mm_add_pd(d_e, _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(d_e, d_e),
+                                                                     _mm_mul_pd(d2, kk))));
+                __m128d t = _mm_and_pd(_mm_div_pd(d2, den), _mm_cmpgt_pd(den, zero));
+                t = _mm_add_pd(_mm_mul_pd(t, last), half);
+                t = _mm_min_pd(_mm_max_pd(t, zero), last);
+                _mm_store_si128((__m128i *)index, _mm_cvttpd_epi32(t));
+                ::memcpy(out + 4 * i, lut + 4 * index[0], 4);
+                ::memcpy(out + 4 * i + 4, lut + 4 * index[1], 4);
+                px = _mm_add_pd(px, two);
+            }
+        }
+#endif
+        for (; i < n; i++)
+        {
+            double dx = dx0 + (double)(x + i) * du;
+            double de = dx * ex + dey;
+            double d2 = dx * dx + dy2;
+            double den = de + std::sqrt(de * de + d2 * k);
+            ::memcpy(out + 4 * i, lut + entry(den > 0 ? d2 / den : 0), 4);
+        }
+    }
+}
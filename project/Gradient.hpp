@@ -0,0 +1,123 @@
+//! @file Gradient.hpp
+#ifndef __svg_Gradient_hpp__
+#define __svg_Gradient_hpp__
+
+#include "Color.hpp"
+#include "Point.hpp"
+
+#include <vector>
+
+namespace svg
+{
+    //! Shape of the lines of equal color of a gradient.
+    enum class GradientKind
+    {
+        //! Straight lines, perpendicular to the gradient vector.
+        linear,
+        //! Circles, from the focal point to the outer circle.
+        radial
+    };
+
+    //! Coordinate system of the control points of a gradient.
+    enum class GradientUnits
+    {
+        //! (0, 0) and (1, 1) are the corners of the painted shape's bounds.
+        bounding_box,
+        //! Drawing coordinates.
+        user_space
+    };
+
+    //! How a gradient continues past its ends.
+    enum class SpreadMethod
+    {
+        //! The end colors extend forever.
+        pad,
+        //! The gradient goes back and forth.
+        reflect,
+        //! The gradient starts over.
+        repeat
+    };
+
+    //! Color at one position along a gradient.
+    struct GradientStop
+    {
+        //! Position, from 0 to 1.
+        double offset;
+        //! Color.
+        Color color;
+        //! Opacity, from 0 to 1.
+        double opacity;
+    };
+
+    //! Linear or radial gradient, with its colors precomputed into a lookup
+    //! table so that painting a pixel needs no search among the stops.
+    class Gradient
+    {
+    public:
+        //! Number of entries of the lookup table.
+        static const int LUT_SIZE = 1024;
+
+        //! Constructor.
+        //! @param kind Linear or radial.
+        //! @param units Coordinate system of the control points.
+        //! @param spread How the gradient continues past its ends.
+        //! @param points Control points. Linear: start and end of the
+        //! gradient vector. Radial: center, focal point, and a point on the
+        //! outer circle.
+        //! @param stops Colors, by increasing offset. Without stops, the
+        //! gradient is transparent.
+        Gradient(GradientKind kind, GradientUnits units, SpreadMethod spread,
+                 const std::vector<Point> &points, const std::vector<GradientStop> &stops);
+        //! Get the coordinate system of the control points.
+        //! @return The units.
+        GradientUnits units() const;
+        //! Check if every color of the gradient is opaque.
+        //! @return true if all stops have opacity 1.
+        bool opaque() const;
+        //! Get the control points.
+        //! @return The points, as passed to the constructor.
+        const std::vector<Point> &points() const;
+        //! Get the colors.
+        //! @return The stops, as passed to the constructor.
+        const std::vector<GradientStop> &stops() const;
+        //! Replace the control points, e.g. after a transform.
+        //! @param points The new points.
+        void set_points(const std::vector<Point> &points);
+        //! Compute the colors of consecutive pixels of a row.
+        //! @param x X drawing coordinate of the first pixel.
+        //! @param y Y drawing coordinate of the row.
+        //! @param n Number of pixels.
+        //! @param box_min Top-left corner of the painted shape's bounds.
+        //! @param box_max Bottom-right corner of the painted shape's bounds.
+        //! @param out Receives n premultiplied RGBA pixels, 4 bytes each.
+        void shade(int x, int y, int n, const Point &box_min, const Point &box_max,
+                   unsigned char *out) const;
+
+    private:
+        //! Lookup table entry for a gradient parameter, after spreading.
+        //! @param t Gradient parameter; 0 and 1 are the ends.
+        //! @return Index of the first byte of the entry.
+        int entry(double t) const;
+        //! Fill pixels with the last color.
+        //! @param n Number of pixels.
+        //! @param out Output pixels.
+        void shade_end(int n, unsigned char *out) const;
+
+        //! Linear or radial.
+        GradientKind kind_;
+        //! Coordinate system of points_.
+        GradientUnits units_;
+        //! Behavior past the ends.
+        SpreadMethod spread_;
+        //! Control points.
+        std::vector<Point> points_;
+        //! Colors.
+        std::vector<GradientStop> stops_;
+        //! Whether all stops are opaque.
+        bool opaque_;
+        //! Premultiplied RGBA colors for LUT_SIZE evenly spaced parameters
+        //! from 0 to 1.
+        std::vector<unsigned char> lut_;
+    };
+}
+#endif
@@ -2,9 +2,19 @@
 
 #include <stdexcept>
 #include <cmath>
+#include <cstdint>
 #include <cstring>
 #include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <new>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define STBI_ONLY_PNG
 #define STB_IMAGE_IMPLEMENTATION
@@ -14,39 +24,297 @@
 
 namespace svg
 {
+    Cancelled::Cancelled(const std::string &what) : std::runtime_error(what)
+    {
+    }
+
+    CancelToken::CancelToken() : cancelled_(false), deadline_(0)
+    {
+    }
+    void CancelToken::cancel()
+    {
+        cancelled_ = true;
+    }
+    void CancelToken::set_deadline(double seconds)
+    {
+        auto at = std::chrono::steady_clock::now() +
+                  std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                      std::chrono::duration<double>(seconds));
+        deadline_ = std::max<long long>(1, at.time_since_epoch().count());
+    }
+    bool CancelToken::cancelled() const
+    {
+        if (cancelled_)
+        {
+            return true;
+        }
+        long long deadline = deadline_;
+        return deadline != 0 &&
+               std::chrono::steady_clock::now().time_since_epoch().count() >= deadline;
+    }
+
     PNGImage::PNGImage(const std::string &png_file_name)
     {
         int dummy;
-        pixels_ = (Color *)::stbi_load(png_file_name.c_str(),
-                                       &width_, &height_,
-                                       &dummy, 3);
-        if (pixels_ == nullptr)
+        data_ = ::stbi_load(png_file_name.c_str(), &width_, &height_, &dummy, 3);
+        if (data_ == nullptr)
         {
             throw std::runtime_error(png_file_name + ": could not load image!");
         }
+        format_ = PixelFormat::rgb;
+        bpp_ = 3;
+        stride_ = width_ * bpp_;
+        capacity_ = (size_t)height_ * stride_;
+        clip_ = {0, 0, width_ - 1, height_ - 1};
+        origin_x_ = origin_y_ = 0;
+        alpha_ = 255;
+        gradient_ = nullptr;
+        cancel_ = nullptr;
+        plotted_ = nullptr;
     }
-    PNGImage::PNGImage(int w, int h)
+    PNGImage::PNGImage(int w, int h, PixelFormat format)
+        : data_(nullptr), capacity_(0)
+    {
+        reset(w, h, format);
+    }
+    void PNGImage::reset(int w, int h, PixelFormat format)
     {
         assert(w > 0 && h > 0);
-        size_t sz = w * h * sizeof(Color);
-        pixels_ = (Color *)::stbi__malloc(sz);
+        // Rows are addressed with int offsets.
+        if (w > (INT32_MAX - 15) / 4)
+        {
+            throw std::runtime_error("Image too large");
+        }
+        format_ = format;
+        bpp_ = format == PixelFormat::rgb ? 3 : 4;
+        // 4-byte pixels are meant for SIMD: every row starts 16-byte aligned
+        // (malloc already aligns the first one).
+        stride_ = bpp_ == 4 ? (w * 4 + 15) & ~15 : w * 3;
+        size_t sz = (size_t)h * stride_;
+        if (sz > capacity_)
+        {
+            stbi_image_free(data_);
+            data_ = (unsigned char *)::stbi__malloc(sz);
+            capacity_ = data_ == nullptr ? 0 : sz;
+            if (data_ == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+        }
         width_ = w;
         height_ = h;
-        ::memset(pixels_, 0xFF, sz);
+        // White, or transparent black.
+        ::memset(data_, format == PixelFormat::rgba ? 0 : 0xFF, sz);
+        clip_ = {0, 0, width_ - 1, height_ - 1};
+        origin_x_ = origin_y_ = 0;
+        alpha_ = 255;
+        gradient_ = nullptr;
+        cancel_ = nullptr;
+        plotted_ = nullptr;
     }
+    namespace
+    {
+        //! Write a 32-bit big-endian number.
+        unsigned char *put32(unsigned char *o, uint32_t v)
+        {
+            o[0] = (unsigned char)(v >> 24);
+            o[1] = (unsigned char)(v >> 16);
+            o[2] = (unsigned char)(v >> 8);
+            o[3] = (unsigned char)v;
+            return o + 4;
+        }
+
+        //! Encode packed pixels as QOI (qoiformat.org). Each pixel becomes
+        //! a run, a reference to a recently seen color, a small difference
+        //! from the previous pixel, or the color itself.
+        //! @param p Pixels, row after row without padding.
+        //! @param w Width.
+        //! @param h Height.
+        //! @param channels 3 for RGB, 4 for RGBA.
+        //! @param out Receives the file contents.
+        void encode_qoi(const unsigned char *p, int w, int h, int channels,
+                        std::vector<unsigned char> &out)
+        {
+            size_t n = (size_t)w * h;
+            // Header, at most 5 bytes per pixel, and end marker.
+            out.resize(14 + n * 5 + 8);
+            unsigned char *o = out.data();
+            ::memcpy(o, "qoif", 4);
+            o = put32(o + 4, (uint32_t)w);
+            o = put32(o, (uint32_t)h);
+            *o++ = (unsigned char)channels;
+            *o++ = 0;
+
+            unsigned char seen[64][4] = {};
+            unsigned char prev[4] = {0, 0, 0, 255}, px[4] = {0, 0, 0, 255};
+            int run = 0;
+            for (size_t i = 0; i < n; i++, p += channels)
+            {
+                ::memcpy(px, p, channels);
+                if (::memcmp(px, prev, 4) == 0)
+                {
+                    // Runs are at most 62 pixels long.
+                    if (++run == 62 || i == n - 1)
+                    {
+                        *o++ = (unsigned char)(0xC0 | (run - 1));
+                        run = 0;
+                    }
+                    continue;
+                }
+                if (run > 0)
+                {
+                    *o++ = (unsigned char)(0xC0 | (run - 1));
+                    run = 0;
+                }
+                int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+                if (::memcmp(seen[hash], px, 4) == 0)
+                {
+                    *o++ = (unsigned char)hash;
+                }
+                else if (px[3] != prev[3])
+                {
+                    ::memcpy(seen[hash], px, 4);
+                    *o++ = 0xFF;
+                    ::memcpy(o, px, 4);
+                    o += 4;
+                }
+                else
+                {
+                    ::memcpy(seen[hash], px, 4);
+                    // Differences wrap around, as unsigned bytes.
+                    signed char dr = (signed char)(px[0] - prev[0]);
+                    signed char dg = (signed char)(px[1] - prev[1]);
+                    signed char db = (signed char)(px[2] - prev[2]);
+                    signed char dr_dg = (signed char)(dr - dg);
+                    signed char db_dg = (signed char)(db - dg);
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                    {
+                        *o++ = (unsigned char)(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    }
+                    else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 &&
+                             db_dg >= -8 && db_dg <= 7)
+                    {
+                        *o++ = (unsigned char)(0x80 | (dg + 32));
+                        *o++ = (unsigned char)((dr_dg + 8) << 4 | (db_dg + 8));
+                    }
+                    else
+                    {
+                        *o++ = 0xFE;
+                        ::memcpy(o, px, 3);
+                        o += 3;
+                    }
+                }
+                ::memcpy(prev, px, 4);
+            }
+            static const unsigned char end[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+            ::memcpy(o, end, 8);
+            out.resize(o + 8 - out.data());
+        }
+    }
+
     void PNGImage::save(const std::string &png_file_name) const
     {
-        ::stbi_write_png(png_file_name.c_str(),
-                         width_,
-                         height_,
-                         3,
-                         pixels_,
-                         width_ * 3);
+        save(png_file_name, format_for(png_file_name));
+    }
+    void PNGImage::save(const std::string &file_name, ImageFormat format) const
+    {
+        std::vector<unsigned char> buffer;
+        int channels;
+        const unsigned char *pixels = packed(buffer, channels, format == ImageFormat::ppm);
+        if (format == ImageFormat::png)
+        {
+            if (::stbi_write_png(file_name.c_str(), width_, height_, channels, pixels,
+                                 width_ * channels) == 0)
+            {
+                throw std::runtime_error(file_name + ": could not write image!");
+            }
+            return;
+        }
+        std::ofstream out(file_name, std::ios::binary);
+        if (!out)
+        {
+            throw std::runtime_error(file_name + ": could not write image!");
+        }
+        size_t size = (size_t)width_ * height_ * channels;
+        if (format == ImageFormat::ppm)
+        {
+            out << "P6\n" << width_ << ' ' << height_ << "\n255\n";
+            out.write((const char *)pixels, size);
+        }
+        else if (format == ImageFormat::raw)
+        {
+            out.write((const char *)pixels, size);
+        }
+        else
+        {
+            std::vector<unsigned char> qoi;
+            encode_qoi(pixels, width_, height_, channels, qoi);
+            out.write((const char *)qoi.data(), qoi.size());
+        }
+        if (!out)
+        {
+            throw std::runtime_error(file_name + ": could not write image!");
+        }
+    }
+    ImageFormat PNGImage::format_for(const std::string &file_name)
+    {
+        size_t dot = file_name.rfind('.');
+        std::string ext = dot == std::string::npos ? "" : file_name.substr(dot + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (ext == "ppm")
+        {
+            return ImageFormat::ppm;
+        }
+        if (ext == "qoi")
+        {
+            return ImageFormat::qoi;
+        }
+        if (ext == "raw")
+        {
+            return ImageFormat::raw;
+        }
+        return ImageFormat::png;
+    }
+    const unsigned char *PNGImage::packed(std::vector<unsigned char> &buffer, int &channels,
+                                          bool color_only) const
+    {
+        channels = format_ == PixelFormat::rgba && !color_only ? 4 : 3;
+        if (format_ == PixelFormat::rgb)
+        {
+            return data_;
+        }
+        buffer.resize((size_t)width_ * height_ * channels);
+        unsigned char *out = buffer.data();
+        for (int y = 0; y < height_; y++)
+        {
+            const unsigned char *p = data_ + (size_t)y * stride_;
+            if (channels == 3)
+            {
+                for (int x = 0; x < width_; x++, p += 4, out += 3)
+                {
+                    out[0] = p[0];
+                    out[1] = p[1];
+                    out[2] = p[2];
+                }
+                continue;
+            }
+            // Files store colors that are not premultiplied.
+            for (int x = 0; x < width_; x++, p += 4, out += 4)
+            {
+                int a = p[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    out[k] = a == 0 ? 0 : (unsigned char)std::min(255, (p[k] * 255 + a / 2) / a);
+                }
+                out[3] = (unsigned char)a;
+            }
+        }
+        return buffer.data();
     }
 
     PNGImage::~PNGImage()
     {
-        stbi_image_free(pixels_);
+        stbi_image_free(data_);
     }
 
     int PNGImage::width() const
@@ -57,25 +325,607 @@ namespace svg
     {
         return height_;
     }
+    PixelFormat PNGImage::format() const
+    {
+        return format_;
+    }
     Color &PNGImage::at(int x, int y)
     {
         assert(x >= 0 && x < width_);
         assert(y >= 0 && y < height_);
-        return pixels_[y * width_ + x];
+        return *(Color *)(data_ + (size_t)y * stride_ + x * bpp_);
     }
     Color PNGImage::at(int x, int y) const
     {
         assert(x >= 0 && x < width_);
         assert(y >= 0 && y < height_);
-        return pixels_[y * width_ + x];
+        return *(const Color *)(data_ + (size_t)y * stride_ + x * bpp_);
+    }
+    const Color *PNGImage::row(int y) const
+    {
+        assert(format_ == PixelFormat::rgb);
+        assert(y >= 0 && y < height_);
+        return (const Color *)(data_ + (size_t)y * stride_);
+    }
+    void PNGImage::set_clip(const Box &box)
+    {
+        clip_ = box.intersect({0, 0, width_ - 1, height_ - 1});
+    }
+    Box PNGImage::clip() const
+    {
+        return clip_;
+    }
+    Box PNGImage::visible() const
+    {
+        return {clip_.x_min + origin_x_, clip_.y_min + origin_y_,
+                clip_.x_max + origin_x_, clip_.y_max + origin_y_};
+    }
+    void PNGImage::set_origin(int x, int y)
+    {
+        origin_x_ = x;
+        origin_y_ = y;
+    }
+    void PNGImage::set_alpha(int alpha)
+    {
+        alpha_ = std::max(0, std::min(255, alpha));
+    }
+    int PNGImage::alpha() const
+    {
+        return alpha_;
+    }
+    void PNGImage::set_gradient(const Gradient *gradient, const Point &box_min,
+                                const Point &box_max)
+    {
+        gradient_ = gradient;
+        gradient_min_ = box_min;
+        gradient_max_ = box_max;
+    }
+    void PNGImage::fill(const Box &box, const Color &c)
+    {
+        Box b = box.intersect({0, 0, width_ - 1, height_ - 1});
+        int alpha = alpha_;
+        alpha_ = 255;
+        for (int y = b.y_min; y <= b.y_max; y++)
+        {
+            paint(data_ + (size_t)y * stride_ + b.x_min * bpp_, b.x_max - b.x_min + 1, c);
+        }
+        alpha_ = alpha;
+    }
+
+    namespace
+    {
+        //! Coordinates are clamped to +/- this many pixels before being
+        //! converted to int, so that huge transforms cannot overflow.
+        const double COORDINATE_LIMIT = 1 << 28;
+
+        //! Clamp a coordinate to +/- COORDINATE_LIMIT; NaN becomes the
+        //! lower limit.
+        inline double clamp_coordinate(double v)
+        {
+            return v > -COORDINATE_LIMIT ? std::min(v, COORDINATE_LIMIT) : -COORDINATE_LIMIT;
+        }
+
+        //! Drawing loops check for cancellation once per this many rows.
+        const int CANCEL_ROWS = 64;
+
+        //! x / 255, rounded, for x in [0, 255 * 255].
+        inline int div255(int x)
+        {
+            x += 128;
+            return (x + (x >> 8)) >> 8;
+        }
+    }
+
+    void PNGImage::paint(unsigned char *p, int n, const Color &c)
+    {
+        if (n <= 0 || alpha_ == 0)
+        {
+            return;
+        }
+        if (alpha_ == 255)
+        {
+            // Opaque: plain overwrite.
+            unsigned char px[4] = {c.red, c.green, c.blue, 255};
+            int i = 0;
+#if defined(__SSE2__)
+            if (bpp_ == 4)
+            {
+                // Rows start 16-byte aligned, so past the first few pixels
+                // of the span every store is aligned.
+                for (; i < n && ((uintptr_t)(p + 4 * i) & 15) != 0; i++)
+                {
+                    ::memcpy(p + 4 * i, px, 4);
+                }
+                int word;
+                ::memcpy(&word, px, 4);
+                const __m128i v = _mm_set1_epi32(word);
+                for (; i + 4 <= n; i += 4)
+                {
+                    _mm_store_si128((__m128i *)(p + 4 * i), v);
+                }
+            }
+            else if (n >= 16)
+            {
+                // 16 pixels are 48 bytes: three registers of repeating colors.
+                alignas(16) unsigned char pattern[48];
+                for (int k = 0; k < 48; k++)
+                {
+                    pattern[k] = px[k % 3];
+                }
+                const __m128i v0 = _mm_load_si128((const __m128i *)pattern);
+                const __m128i v1 = _mm_load_si128((const __m128i *)(pattern + 16));
+                const __m128i v2 = _mm_load_si128((const __m128i *)(pattern + 32));
+                for (; i + 16 <= n; i += 16)
+                {
+                    _mm_storeu_si128((__m128i *)(p + 3 * i), v0);
+                    _mm_storeu_si128((__m128i *)(p + 3 * i + 16), v1);
+                    _mm_storeu_si128((__m128i *)(p + 3 * i + 32), v2);
+                }
+            }
+#endif
+            if (bpp_ == 3)
+            {
+                std::fill((Color *)p + i, (Color *)p + n, c);
+            }
+            else
+            {
+                for (; i < n; i++)
+                {
+                    ::memcpy(p + 4 * i, px, 4);
+                }
+            }
+            return;
+        }
+
+        // Source over, premultiplied: dst = src * alpha + dst * (1 - alpha).
+        // Every byte, alpha included, is the source byte plus the
+        // destination byte scaled by the same factor.
+        int inverse = 255 - alpha_;
+        unsigned char src[4] = {(unsigned char)div255(c.red * alpha_),
+                                (unsigned char)div255(c.green * alpha_),
+                                (unsigned char)div255(c.blue * alpha_),
+                                (unsigned char)alpha_};
+        size_t bytes = (size_t)n * bpp_, i = 0;
+#if defined(__SSE2__)
+        // 48 bytes hold a whole number of 3- and 4-byte pixels, so three
+        // registers of source bytes repeat across the span.
+        if (bytes >= 48)
+        {
+            alignas(16) unsigned char pattern[48];
+            for (int k = 0; k < 48; k++)
+            {
+                pattern[k] = src[k % bpp_];
+            }
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i scale = _mm_set1_epi16((short)inverse);
+            const __m128i half = _mm_set1_epi16(128);
+            for (; i + 48 <= bytes; i += 48)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    __m128i d = _mm_loadu_si128((const __m128i *)(p + i + 16 * k));
+                    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), scale), half);
+                    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), scale), half);
+                    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+                    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+                    __m128i s = _mm_load_si128((const __m128i *)(pattern + 16 * k));
+                    _mm_storeu_si128((__m128i *)(p + i + 16 * k),
+                                     _mm_adds_epu8(_mm_packus_epi16(lo, hi), s));
+                }
+            }
+        }
+#endif
+        for (; i < bytes; i++)
+        {
+            p[i] = (unsigned char)std::min(255, src[i % bpp_] + div255(p[i] * inverse));
+        }
+    }
+
+    namespace
+    {
+        //! Blend premultiplied RGBA pixels over a run of pixels, source
+        //! over, with an extra opacity for the whole run.
+        //! @param d First byte of the first destination pixel.
+        //! @param bpp Bytes per destination pixel; 4-byte pixels have alpha
+        //! (or padding) last.
+        //! @param s Source pixels, 4 bytes each.
+        //! @param n Number of pixels.
+        //! @param alpha Opacity of the source, from 0 to 255.
+        void blend(unsigned char *d, int bpp, const unsigned char *s, int n, int alpha)
+        {
+            int i = 0;
+#if defined(__SSE2__)
+            // Four RGBA pixels at a time; the alpha of each pixel is
+            // broadcast to its four 16-bit lanes.
+            if (bpp == 4)
+            {
+                const __m128i zero = _mm_setzero_si128();
+                const __m128i scale = _mm_set1_epi16((short)alpha);
+                const __m128i full = _mm_set1_epi16(255);
+                const __m128i half = _mm_set1_epi16(128);
+                for (; i + 4 <= n; i += 4)
+                {
+                    __m128i sv = _mm_loadu_si128((const __m128i *)(s + 4 * i));
+                    if (_mm_movemask_epi8(_mm_cmpeq_epi8(sv, zero)) == 0xFFFF)
+                    {
+                        continue;   // Nothing drawn there.
+                    }
+                    __m128i dv = _mm_loadu_si128((const __m128i *)(d + 4 * i));
+                    __m128i s_half[2] = {_mm_unpacklo_epi8(sv, zero), _mm_unpackhi_epi8(sv, zero)};
+                    __m128i d_half[2] = {_mm_unpacklo_epi8(dv, zero), _mm_unpackhi_epi8(dv, zero)};
+                    for (int k = 0; k < 2; k++)
+                    {
+                        __m128i src = _mm_add_epi16(_mm_mullo_epi16(s_half[k], scale), half);
+                        src = _mm_srli_epi16(_mm_add_epi16(src, _mm_srli_epi16(src, 8)), 8);
+                        __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, 0xFF), 0xFF);
+                        __m128i dst = _mm_add_epi16(_mm_mullo_epi16(d_half[k], _mm_sub_epi16(full, a)), half);
+                        dst = _mm_srli_epi16(_mm_add_epi16(dst, _mm_srli_epi16(dst, 8)), 8);
+                        s_half[k] = src;
+                        d_half[k] = dst;
+                    }
+                    _mm_storeu_si128((__m128i *)(d + 4 * i),
+                                     _mm_adds_epu8(_mm_packus_epi16(s_half[0], s_half[1]),
+                                                   _mm_packus_epi16(d_half[0], d_half[1])));
+                }
+            }
+#endif
+            for (; i < n; i++)
+            {
+                const unsigned char *sp = s + 4 * i;
+                unsigned char *dp = d + bpp * i;
+                int a = div255(sp[3] * alpha);
+                if (a == 0)
+                {
+                    continue;
+                }
+                int inverse = 255 - a;
+                for (int k = 0; k < 3; k++)
+                {
+                    dp[k] = (unsigned char)std::min(255, div255(sp[k] * alpha) + div255(dp[k] * inverse));
+                }
+                if (bpp == 4)
+                {
+                    dp[3] = (unsigned char)(a + div255(dp[3] * inverse));
+                }
+            }
+        }
+    }
+
+    void PNGImage::composite(const PNGImage &layer, int alpha)
+    {
+        assert(layer.format_ == PixelFormat::rgba);
+        alpha = std::max(0, std::min(255, alpha));
+        // The layer, in pixels of this image.
+        int dx = layer.origin_x_ - origin_x_, dy = layer.origin_y_ - origin_y_;
+        Box b = Box{dx, dy, dx + layer.width_ - 1, dy + layer.height_ - 1}.intersect(clip_);
+        if (b.empty() || alpha == 0)
+        {
+            return;
+        }
+        int n = b.x_max - b.x_min + 1;
+        for (int y = b.y_min; y <= b.y_max; y++)
+        {
+            blend(data_ + (size_t)y * stride_ + b.x_min * bpp_, bpp_,
+                  layer.data_ + (size_t)(y - dy) * layer.stride_ + (b.x_min - dx) * 4, n, alpha);
+        }
+    }
+
+    void PNGImage::downscale(PNGImage &out) const
+    {
+        assert(out.format_ == format_);
+        int k = width_ / out.width_;
+        if (k >= 1 && k < 256 && width_ == out.width_ * k && height_ == out.height_ * k)
+        {
+            downscale_box(out, k);
+        }
+        else
+        {
+            downscale_area(out);
+        }
+    }
+
+    void PNGImage::downscale_box(PNGImage &out, int k) const
+    {
+        // Sums of k rows, byte by byte; at most 255 * 255 fits in 16 bits.
+        int bytes = width_ * bpp_;
+        std::vector<uint16_t> sums(bytes);
+        // Dividing by the area is multiplying by its rounded up inverse:
+        // with sums below 2^24 and the area below 2^16, the error stays
+        // under the gap to the next integer.
+        uint32_t area = k * k;
+        uint64_t inverse = (((uint64_t)1 << 40) + area - 1) / area;
+        for (int oy = 0; oy < out.height_; oy++)
+        {
+            std::fill(sums.begin(), sums.end(), 0);
+            for (int y = oy * k; y < (oy + 1) * k; y++)
+            {
+                const unsigned char *p = data_ + (size_t)y * stride_;
+                uint16_t *s = sums.data();
+                int i = 0;
+#if defined(__SSE2__)
+                const __m128i zero = _mm_setzero_si128();
+                for (; i + 16 <= bytes; i += 16)
+                {
+                    __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+                    __m128i lo = _mm_loadu_si128((const __m128i *)(s + i));
+                    __m128i hi = _mm_loadu_si128((const __m128i *)(s + i + 8));
+                    _mm_storeu_si128((__m128i *)(s + i), _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero)));
+                    _mm_storeu_si128((__m128i *)(s + i + 8), _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero)));
+                }
+#endif
+                for (; i < bytes; i++)
+                {
+                    s[i] += p[i];
+                }
+            }
+            // Then k pixels of the sums make one output pixel.
+            unsigned char *o = out.data_ + (size_t)oy * out.stride_;
+            const uint16_t *s = sums.data();
+            int ox = 0;
+#if defined(__SSE2__)
+            if (k == 2 && bpp_ == 4)
+            {
+                // Supersampling by 2: four pixels of sums make two output
+                // pixels, and the sums of four stay within 16 bits.
+                const __m128i two = _mm_set1_epi16(2);
+                for (; ox + 4 <= out.width_; ox += 4, o += 16, s += 32)
+                {
+                    __m128i a = _mm_loadu_si128((const __m128i *)s);
+                    __m128i b = _mm_loadu_si128((const __m128i *)(s + 8));
+                    __m128i c = _mm_loadu_si128((const __m128i *)(s + 16));
+                    __m128i d = _mm_loadu_si128((const __m128i *)(s + 24));
+                    __m128i ab = _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+                    __m128i cd = _mm_add_epi16(_mm_unpacklo_epi64(c, d), _mm_unpackhi_epi64(c, d));
+                    ab = _mm_srli_epi16(_mm_add_epi16(ab, two), 2);
+                    cd = _mm_srli_epi16(_mm_add_epi16(cd, two), 2);
+                    _mm_storeu_si128((__m128i *)o, _mm_packus_epi16(ab, cd));
+                }
+            }
+#endif
+            for (; k == 2 && bpp_ == 3 && ox < out.width_; ox++, o += 3, s += 6)
+            {
+                int r = s[0] + s[3] + 2, g = s[1] + s[4] + 2, b = s[2] + s[5] + 2;
+                o[0] = (unsigned char)(r >> 2);
+                o[1] = (unsigned char)(g >> 2);
+                o[2] = (unsigned char)(b >> 2);
+            }
+            for (; ox < out.width_; ox++, o += bpp_, s += k * bpp_)
+            {
+                for (int c = 0; c < bpp_; c++)
+                {
+                    uint64_t total = area / 2;
+                    for (int x = 0; x < k; x++)
+                    {
+                        total += s[x * bpp_ + c];
+                    }
+                    o[c] = (unsigned char)((total * inverse) >> 40);
+                }
+            }
+        }
+    }
+
+    namespace
+    {
+        //! Source pixel and its share of an output pixel.
+        struct Tap
+        {
+            int index;
+            float weight;
+        };
+
+        //! Share of each source pixel in each output pixel, along one axis.
+        //! @param from Source size.
+        //! @param to Output size.
+        //! @param first Receives, for each output pixel plus one, the index
+        //! of its first tap.
+        //! @return The taps of all output pixels, one after the other.
+        std::vector<Tap> taps(int from, int to, std::vector<int> &first)
+        {
+            std::vector<Tap> result;
+            double scale = (double)from / to;
+            first.assign(1, 0);
+            for (int i = 0; i < to; i++)
+            {
+                double lo = i * scale, hi = (i + 1) * scale;
+                for (int j = (int)lo; j < from && j < hi; j++)
+                {
+                    double overlap = std::min(hi, j + 1.0) - std::max(lo, (double)j);
+                    if (overlap > 0)
+                    {
+                        result.push_back({j, (float)(overlap / scale)});
+                    }
+                }
+                first.push_back((int)result.size());
+            }
+            return result;
+        }
+    }
+
+    void PNGImage::downscale_area(PNGImage &out) const
+    {
+        std::vector<int> x_first, y_first;
+        std::vector<Tap> x_taps = taps(width_, out.width_, x_first);
+        std::vector<Tap> y_taps = taps(height_, out.height_, y_first);
+        int bytes = width_ * bpp_;
+        std::vector<float> row(bytes);
+        for (int oy = 0; oy < out.height_; oy++)
+        {
+            // Blend the source rows first, then the columns of the result.
+            std::fill(row.begin(), row.end(), 0.0f);
+            for (int t = y_first[oy]; t < y_first[oy + 1]; t++)
+            {
+                const unsigned char *p = data_ + (size_t)y_taps[t].index * stride_;
+                float w = y_taps[t].weight;
+                for (int i = 0; i < bytes; i++)
+                {
+                    row[i] += p[i] * w;
+                }
+            }
+            unsigned char *o = out.data_ + (size_t)oy * out.stride_;
+            for (int ox = 0; ox < out.width_; ox++, o += bpp_)
+            {
+                float sum[4] = {0, 0, 0, 0};
+                for (int t = x_first[ox]; t < x_first[ox + 1]; t++)
+                {
+                    const float *p = &row[x_taps[t].index * bpp_];
+                    for (int c = 0; c < bpp_; c++)
+                    {
+                        sum[c] += p[c] * x_taps[t].weight;
+                    }
+                }
+                for (int c = 0; c < bpp_; c++)
+                {
+                    o[c] = (unsigned char)std::min(255.0f, sum[c] + 0.5f);
+                }
+            }
+        }
+    }
+
+    void PNGImage::set_cancel(const CancelToken *token)
+    {
+        cancel_ = token;
+    }
+
+    const CancelToken *PNGImage::cancel_token() const
+    {
+        return cancel_;
+    }
+
+    void PNGImage::check_cancel() const
+    {
+        if (cancel_ != nullptr && cancel_->cancelled())
+        {
+            throw Cancelled("Drawing cancelled");
+        }
+    }
+
+    void PNGImage::paint_gradient(unsigned char *p, int x, int y, int n)
+    {
+        if (alpha_ == 0)
+        {
+            return;
+        }
+        bool opaque = alpha_ == 255 && gradient_->opaque();
+        if (opaque && bpp_ == 4)
+        {
+            // The colors are the pixels.
+            gradient_->shade(x, y, n, gradient_min_, gradient_max_, p);
+            return;
+        }
+        // Shaded a block at a time, to keep the colors in cache.
+        const int BLOCK = 256;
+        unsigned char colors[BLOCK * 4];
+        for (int i = 0; i < n; i += BLOCK)
+        {
+            int m = std::min(BLOCK, n - i);
+            gradient_->shade(x + i, y, m, gradient_min_, gradient_max_, colors);
+            unsigned char *d = p + (size_t)i * bpp_;
+            if (!opaque)
+            {
+                blend(d, bpp_, colors, m, alpha_);
+                continue;
+            }
+            for (int k = 0; k < m; k++)
+            {
+                ::memcpy(d + 3 * k, colors + 4 * k, 3);
+            }
+        }
+    }
+
+    void PNGImage::plot(int x, int y, const Color &c)
+    {
+        x -= origin_x_;
+        y -= origin_y_;
+        if (x >= clip_.x_min && x <= clip_.x_max &&
+            y >= clip_.y_min && y <= clip_.y_max)
+        {
+            if (plotted_ != nullptr)
+            {
+                plotted_->push_back({y + origin_y_, x + origin_x_});
+                return;
+            }
+            unsigned char *p = data_ + (size_t)y * stride_ + x * bpp_;
+            if (gradient_ != nullptr)
+            {
+                paint_gradient(p, x + origin_x_, y + origin_y_, 1);
+            }
+            else
+            {
+                paint(p, 1, c);
+            }
+        }
+    }
+    void PNGImage::fill_span(int y, int x_from, int x_to, const Color &c)
+    {
+        y -= origin_y_;
+        x_from -= origin_x_;
+        x_to -= origin_x_;
+        if (y < clip_.y_min || y > clip_.y_max)
+        {
+            return;
+        }
+        x_from = std::max(x_from, clip_.x_min);
+        x_to = std::min(x_to, clip_.x_max);
+        if (x_from > x_to)
+        {
+            return;
+        }
+        unsigned char *p = data_ + (size_t)y * stride_ + x_from * bpp_;
+        if (gradient_ != nullptr)
+        {
+            paint_gradient(p, x_from + origin_x_, y + origin_y_, x_to - x_from + 1);
+        }
+        else
+        {
+            paint(p, x_to - x_from + 1, c);
+        }
     }
     void PNGImage::draw_line(const Point &a, const Point &b, const Color &c)
     {
-        //  Bresenham Algorithm.
-        int x_from = a.x;
-        int y_from = a.y;
-        int x_to = b.x;
-        int y_to = b.y;
+        // Far outside the clip box, the line is first cut to a margin
+        // around it, so that huge coordinates do not mean a long walk.
+        if (!std::isfinite(a.x + a.y + b.x + b.y))
+        {
+            return;
+        }
+        Point p = a, q = b;
+        Box v = visible();
+        const double MARGIN = 1 << 16;
+        double lo_x = v.x_min - MARGIN, hi_x = v.x_max + MARGIN;
+        double lo_y = v.y_min - MARGIN, hi_y = v.y_max + MARGIN;
+        auto outside = [&](const Point &r)
+        { return !(r.x >= lo_x && r.x <= hi_x && r.y >= lo_y && r.y <= hi_y); };
+        if (outside(p) || outside(q))
+        {
+            // Liang-Barsky: the part of p + t (q - p) inside, for t in [0, 1].
+            double t0 = 0, t1 = 1, d[2] = {q.x - p.x, q.y - p.y};
+            double from[2] = {p.x, p.y}, lo[2] = {lo_x, lo_y}, hi[2] = {hi_x, hi_y};
+            for (int k = 0; k < 2 && t0 <= t1; k++)
+            {
+                if (d[k] == 0)
+                {
+                    if (!(from[k] >= lo[k] && from[k] <= hi[k]))
+                    {
+                        return;
+                    }
+                    continue;
+                }
+                double ta = (lo[k] - from[k]) / d[k], tb = (hi[k] - from[k]) / d[k];
+                t0 = std::max(t0, std::min(ta, tb));
+                t1 = std::min(t1, std::max(ta, tb));
+            }
+            if (!(t0 <= t1))
+            {
+                return;
+            }
+            p = {from[0] + t0 * d[0], from[1] + t0 * d[1]};
+            q = {from[0] + t1 * d[0], from[1] + t1 * d[1]};
+        }
+        //  Bresenham Algorithm, between the pixels nearest to each end point.
+        int x_from = (int)::lround(p.x);
+        int y_from = (int)::lround(p.y);
+        int x_to = (int)::lround(q.x);
+        int y_to = (int)::lround(q.y);
         int dy = y_to - y_from;
         int dx = x_to - x_from;
         int step_x = 1, step_y = 1;
@@ -91,12 +941,16 @@ namespace svg
         }
         dy *= 2;
         dx *= 2;
-        at(x_from, y_from) = c;
+        plot(x_from, y_from, c);
         if (dx > dy)
         {
             int fraction = dy - (dx / 2);
-            while (x_from != x_to)
+            for (int i = 1; x_from != x_to; i++)
             {
+                if (i % (CANCEL_ROWS << 10) == 0)
+                {
+                    check_cancel();
+                }
                 if (fraction >= 0)
                 {
                     y_from += step_y;
@@ -104,14 +958,18 @@ namespace svg
                 }
                 x_from += step_x;
                 fraction += dy;
-                at(x_from, y_from) = c;
+                plot(x_from, y_from, c);
             }
         }
         else
         {
             int fraction = dx - (dy >> 1);
-            while (y_from != y_to)
+            for (int i = 1; y_from != y_to; i++)
             {
+                if (i % (CANCEL_ROWS << 10) == 0)
+                {
+                    check_cancel();
+                }
                 if (fraction >= 0)
                 {
                     x_from += step_x;
@@ -119,93 +977,328 @@ namespace svg
                 }
                 y_from += step_y;
                 fraction += dx;
-                at(x_from, y_from) = c;
+                plot(x_from, y_from, c);
             }
         }
     }
 
-    void PNGImage::draw_polygon(const std::vector<Point> &points, const Color &c)
+    void PNGImage::draw_polygon(const std::vector<Point> &input, const Color &c)
+    {
+        draw_polygon(input.data(), input.size(), c);
+    }
+
+    void PNGImage::draw_polygon(const Point *input, size_t n, const Color &c)
+    {
+        draw_polygon(input, &n, 1, FillRule::evenodd, c);
+    }
+
+    namespace
+    {
+        //! Non-horizontal polygon edge, crossing rows y_top to y_bottom - 1.
+        struct Edge
+        {
+            Point a, b;
+            int y_top, y_bottom;
+            //! +1 for downward edges, -1 for upward ones.
+            int winding;
+        };
+
+        //! Edge crossing the current row, and where.
+        struct Crossing
+        {
+            const Edge *edge;
+            double x;
+        };
+
+        //! Row and columns of a filled span, in drawing coordinates.
+        struct Span
+        {
+            int y, x_from, x_to;
+        };
+
+        //! Spans and outline pixels of translucent polygons, kept to reuse
+        //! their memory.
+        thread_local std::vector<Span> polygon_spans;
+        thread_local std::vector<std::pair<int, int>> outline_pixels;
+    }
+
+    void PNGImage::draw_polygon(const Point *input, const size_t *ends, size_t contours,
+                                FillRule rule, const Color &c)
     {
-        int x_min = width(), x_max = 0, y_min = height(), y_max = 0;
-        for (const Point &p : points)
+        // Vertices are snapped to the pixel grid once, here, so transforms
+        // upstream never accumulate rounding errors.
+        size_t n = contours == 0 ? 0 : ends[contours - 1];
+        std::vector<Point> points(n);
+        for (size_t i = 0; i < n; i++)
         {
-            x_min = std::min(x_min, p.x);
-            x_max = std::max(x_max, p.x);
-            y_min = std::min(y_min, p.y);
-            y_max = std::max(y_max, p.y);
+            points[i] = {round(clamp_coordinate(input[i].x)), round(clamp_coordinate(input[i].y))};
         }
 
-        std::vector<double> seg;
-        for (int y = y_min; y < y_max; y++)
+        // Edges of all contours, ordered by first row. Each edge covers its
+        // rows half-open, so a vertex shared by two edges is counted once.
+        std::vector<Edge> edges;
+        edges.reserve(n);
+        for (size_t k = 0, first = 0; k < contours; first = ends[k], k++)
         {
-            for (size_t i = 0; i < points.size(); i++)
+            for (size_t i = first; i < ends[k]; i++)
             {
                 Point a = points[i];
-                Point b = points[(i + 1) % points.size()];
-                if (y < std::min(a.y, b.y) || y > std::max(a.y, b.y))
+                Point b = points[i + 1 < ends[k] ? i + 1 : first];
+                if (a.y != b.y)
                 {
-                    continue;
+                    edges.push_back({a, b, (int)std::min(a.y, b.y), (int)std::max(a.y, b.y),
+                                     b.y > a.y ? 1 : -1});
                 }
-                if (a.y != b.y)
+            }
+        }
+        std::sort(edges.begin(), edges.end(), [](const Edge &e, const Edge &f)
+                  { return e.y_top < f.y_top; });
+
+        // Translucent pixels must blend once, so the spans are kept to
+        // tell which outline pixels they already painted.
+        bool opaque = alpha_ == 255 && (gradient_ == nullptr || gradient_->opaque());
+        polygon_spans.clear();
+
+        // Rows outside the clip box cannot produce pixels.
+        int y_min = edges.empty() ? 0 : std::max(edges.front().y_top, clip_.y_min + origin_y_);
+        int y_max = clip_.y_max + origin_y_;
+
+        // Active edges are kept sorted by crossing. Crossings move little
+        // from one row to the next, so insertion sort is nearly linear.
+        std::vector<Crossing> active;
+        size_t next = 0;
+        for (int y = y_min; y <= y_max && (next < edges.size() || !active.empty()); y++)
+        {
+            if ((y - y_min) % CANCEL_ROWS == 0)
+            {
+                check_cancel();
+            }
+            size_t kept = 0;
+            for (const Crossing &cr : active)
+            {
+                if (cr.edge->y_bottom > y)
                 {
-                    double x_inters = (double)(y - a.y) * (b.x - a.x) / (double)(b.y - a.y) + a.x;
-                    seg.push_back(x_inters);
+                    active[kept++] = cr;
                 }
             }
-            std::sort(seg.begin(), seg.end());
-            size_t i_s = 0;
-            while ((i_s + 1) < seg.size())
+            active.resize(kept);
+            // Edges that start above a clipped first row may also end there.
+            for (; next < edges.size() && edges[next].y_top <= y; next++)
             {
-                Point a = {(int)round(seg.at(i_s)), y};
-                Point b = {(int)round(seg.at(i_s + 1)), y};
-                if (a.x == b.x)
+                if (edges[next].y_bottom > y)
                 {
-                    i_s++;
+                    active.push_back({&edges[next], 0});
                 }
-                else
+            }
+            for (size_t i = 0; i < active.size(); i++)
+            {
+                const Edge *e = active[i].edge;
+                Crossing cr = {e, (y - e->a.y) * (e->b.x - e->a.x) / (e->b.y - e->a.y) + e->a.x};
+                size_t j = i;
+                for (; j > 0 && active[j - 1].x > cr.x; j--)
                 {
-                    draw_line(a, b, c);
-                    i_s += 2;
+                    active[j] = active[j - 1];
+                }
+                active[j] = cr;
+            }
+
+            // Fill from where the winding number becomes inside to where
+            // it becomes outside again.
+            int winding = 0;
+            double x_from = 0;
+            for (const Crossing &cr : active)
+            {
+                bool was_inside = rule == FillRule::nonzero ? winding != 0 : (winding & 1) != 0;
+                winding += cr.edge->winding;
+                bool inside = rule == FillRule::nonzero ? winding != 0 : (winding & 1) != 0;
+                if (!was_inside && inside)
+                {
+                    x_from = cr.x;
+                }
+                else if (was_inside && !inside)
+                {
+                    Span span = {y, (int)round(x_from), (int)round(cr.x)};
+                    if (!opaque)
+                    {
+                        // Rounding may make spans of a row share a pixel.
+                        if (!polygon_spans.empty() && polygon_spans.back().y == y)
+                        {
+                            span.x_from = std::max(span.x_from, polygon_spans.back().x_to + 1);
+                        }
+                        if (span.x_from > span.x_to)
+                        {
+                            continue;
+                        }
+                        polygon_spans.push_back(span);
+                    }
+                    fill_span(span.y, span.x_from, span.x_to, c);
                 }
             }
-            seg.clear();
         }
-        for (size_t i = 0; i < points.size(); i++)
+
+        // The outline covers the pixels the half-open spans miss, such as
+        // the last row. When translucent, it is gathered first, and only
+        // the pixels no span painted are painted.
+        outline_pixels.clear();
+        plotted_ = opaque ? nullptr : &outline_pixels;
+        try
         {
-            draw_line(points[i], points[(i + 1) % points.size()], c);
+            for (size_t k = 0, first = 0; k < contours; first = ends[k], k++)
+            {
+                for (size_t i = first; i < ends[k]; i++)
+                {
+                    draw_line(points[i], points[i + 1 < ends[k] ? i + 1 : first], c);
+                }
+            }
+        }
+        catch (...)
+        {
+            plotted_ = nullptr;
+            throw;
+        }
+        plotted_ = nullptr;
+        if (opaque)
+        {
+            return;
+        }
+        // Spans come row by row, left to right, without overlapping. Most
+        // outline pixels lie in one of them; the few left may repeat.
+        auto before = [](const Span &span, const std::pair<int, int> &p)
+        { return span.y < p.first || (span.y == p.first && span.x_to < p.second); };
+        size_t kept = 0;
+        for (const std::pair<int, int> &p : outline_pixels)
+        {
+            auto span = std::lower_bound(polygon_spans.begin(), polygon_spans.end(), p, before);
+            if (span == polygon_spans.end() || span->y != p.first || span->x_from > p.second)
+            {
+                outline_pixels[kept++] = p;
+            }
+        }
+        outline_pixels.resize(kept);
+        std::sort(outline_pixels.begin(), outline_pixels.end());
+        outline_pixels.erase(std::unique(outline_pixels.begin(), outline_pixels.end()),
+                             outline_pixels.end());
+        for (const std::pair<int, int> &p : outline_pixels)
+        {
+            plot(p.second, p.first, c);
         }
     }
 
-    void PNGImage::draw_ellipse(const Point &center, const Point &radius, const Color &fill)
+    void PNGImage::draw_ellipse(const Point &c, const Point &r, const Color &fill)
     {
-        draw_line(center.translate({-radius.x, 0}),
-                  center.translate({+radius.x, 0}),
-                  fill);
-        int x0 = radius.x;
+        // The axis-aligned filler works on whole pixels.
+        int cx = (int)round(clamp_coordinate(c.x)), cy = (int)round(clamp_coordinate(c.y));
+        int rx = (int)round(clamp_coordinate(r.x)), ry = (int)round(clamp_coordinate(r.y));
+        fill_span(cy, cx - rx, cx + rx, fill);
+        if (rx < 0)
+        {
+            return;
+        }
+        // Row y spans [-x, x] for the largest x with
+        // e = x^2 ry^2 + y^2 rx^2 - rx^2 ry^2 <= 0. Rows are walked down from
+        // the center, and x only decreases, by at least one less than on
+        // the previous row since the ellipse is convex.
+        // rx^2 ry^2 fits in 64 bits while rx * ry stays below 2^31.
+        const int64_t A = (int64_t)rx * rx, B = (int64_t)ry * ry;
+        bool exact = (int64_t)(rx + 1) * (ry + 1) < ((int64_t)1 << 31);
+        // Past this row, both mirrored rows are outside the clip box.
+        Box v = visible();
+        int y_end = std::min(ry, std::max(cy - v.y_min, v.y_max - cy));
+        // Before this row, both are outside it too; the walk then starts
+        // from a bound on x just above the ellipse.
+        int y_start = std::max(1, std::max(v.y_min - cy, cy - v.y_max));
+        int x0 = rx;
+        if (y_start > 1 && y_start <= y_end)
+        {
+            double vy = (double)(y_start - 1) / ry;
+            x0 = std::min(rx, (int)std::ceil(rx * std::sqrt(std::max(0.0, 1 - vy * vy))) + 2);
+        }
         int dx = 0;
-        for (int y = 1; y <= radius.y; y++)
+        for (int y = y_start; y <= y_end; y++)
         {
-            double vy = (double)y / (double)radius.y;
-            vy *= vy;
+            if (y % CANCEL_ROWS == 0)
+            {
+                check_cancel();
+            }
             int x1 = x0 - (dx - 1);
-            for (; x1 > 0; x1--)
+            if (exact)
+            {
+                int64_t e = (int64_t)x1 * x1 * B + (int64_t)y * y * A - A * B;
+                for (; x1 > 0 && e > 0; x1--)
+                {
+                    e -= (2 * (int64_t)x1 - 1) * B;
+                }
+            }
+            else
             {
-                double vx = (double)x1 / (double)radius.x;
-                vx *= vx;
-                if (vx + vy <= 1)
+                // Beyond 64 bits: the same test, relative to 1.
+                double vy = (double)y / ry;
+                vy *= vy;
+                for (; x1 > 0; x1--)
                 {
-                    break;
+                    double vx = (double)x1 / rx;
+                    if (vx * vx + vy <= 1)
+                    {
+                        break;
+                    }
                 }
             }
-            dx = x0 - x1;
+            // The step down to the first row says nothing of the slope.
+            dx = y == y_start ? 0 : x0 - x1;
             x0 = x1;
-            draw_line(center.translate({-x0, -y}),
-                      center.translate({+x0, -y}),
-                      fill);
-            draw_line(center.translate({-x0, +y}),
-                      center.translate({+x0, +y}),
-                      fill);
+            fill_span(cy - y, cx - x0, cx + x0, fill);
+            fill_span(cy + y, cx - x0, cx + x0, fill);
         }
     }
 
+    void PNGImage::draw_ellipse(const Point &c, const Point &r, double degrees,
+                                const Color &fill)
+    {
+        // Quarter turns keep the axes horizontal and vertical, and the same
+        // pixels as the axis-aligned filler.
+        double turns = std::fmod(degrees, 180.0);
+        if (turns == 0 || r.x == r.y)
+        {
+            draw_ellipse(c, r, fill);
+            return;
+        }
+        if (std::fabs(turns) == 90)
+        {
+            draw_ellipse(c, {r.y, r.x}, fill);
+            return;
+        }
+        if (!(r.x > 0 && r.y > 0))
+        {
+            return;
+        }
+        // Relative to the center, the ellipse is A x^2 + B x y + C y^2 <= 1,
+        // so row y spans the roots of A x^2 + B y x + (C y^2 - 1), centered
+        // on -B y / 2A, with a discriminant of 4A - 4y^2 / (rx^2 ry^2).
+        double angle = M_PI * degrees / 180.0;
+        double s = std::sin(angle), k = std::cos(angle);
+        double ax = 1 / (r.x * r.x), ay = 1 / (r.y * r.y);
+        double A = k * k * ax + s * s * ay;
+        double B = 2 * s * k * (ax - ay);
+        double D = ax * ay;
+        double h = std::sqrt(r.x * r.x * s * s + r.y * r.y * k * k);
+        Box v = visible();
+        int y_from = std::max((int)std::ceil(clamp_coordinate(c.y - h)), v.y_min);
+        int y_to = std::min((int)std::floor(clamp_coordinate(c.y + h)), v.y_max);
+        for (int y = y_from; y <= y_to; y++)
+        {
+            if ((y - y_from) % CANCEL_ROWS == 0)
+            {
+                check_cancel();
+            }
+            double dy = y - c.y;
+            double disc = A - dy * dy * D;
+            if (disc < 0)
+            {
+                continue;
+            }
+            double mid = c.x - B * dy / (2 * A), w = std::sqrt(disc) / A;
+            fill_span(y, (int)std::ceil(clamp_coordinate(mid - w)),
+                      (int)std::floor(clamp_coordinate(mid + w)), fill);
+        }
+    }
 }
@@ -3,13 +3,88 @@
 #define __svg_png_image_hpp__
 
 #include "Color.hpp"
+#include "Gradient.hpp"
 #include "Point.hpp"
 
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace svg
 {
+    //! Rule deciding which points are inside a shape with several
+    //! contours, or a contour that crosses itself.
+    enum class FillRule
+    {
+        //! Inside if contours wind around the point a non-zero number of
+        //! times, counting clockwise as +1 and counter-clockwise as -1.
+        nonzero,
+        //! Inside if a ray from the point crosses contours an odd number
+        //! of times.
+        evenodd
+    };
+
+    //! Layout of the pixels of an image.
+    enum class PixelFormat
+    {
+        //! Opaque 8-bit red, green and blue.
+        rgb,
+        //! Opaque 8-bit red, green and blue, padded to 4 bytes per pixel
+        //! so that pixels and rows are aligned for drawing. Saved as RGB.
+        rgbx,
+        //! 8-bit red, green, blue and alpha, with the colors premultiplied
+        //! by alpha.
+        rgba
+    };
+
+    //! File format written by PNGImage::save.
+    enum class ImageFormat
+    {
+        //! Deflate-compressed PNG.
+        png,
+        //! Binary PPM (P6): a short text header, then RGB bytes.
+        ppm,
+        //! QOI: lossless, encoded in a single pass without compression.
+        qoi,
+        //! RGB or RGBA bytes only, row after row, without any header.
+        raw
+    };
+
+    //! Thrown by drawing functions once their CancelToken is cancelled.
+    class Cancelled : public std::runtime_error
+    {
+    public:
+        //! Constructor.
+        //! @param what Reason.
+        explicit Cancelled(const std::string &what);
+    };
+
+    //! Lets another thread, or a deadline, stop a drawing in progress.
+    //! Drawing functions check the token every so many rows or pixels.
+    class CancelToken
+    {
+    public:
+        //! Constructor, without deadline.
+        CancelToken();
+        //! Stop drawing as soon as possible. May be called from any thread.
+        void cancel();
+        //! Stop drawing once some time has passed.
+        //! @param seconds Time from now.
+        void set_deadline(double seconds);
+        //! Check if drawing should stop.
+        //! @return true once cancelled or past the deadline.
+        bool cancelled() const;
+
+    private:
+        //! Set by cancel().
+        std::atomic<bool> cancelled_;
+        //! Deadline, in steady clock ticks, or 0 for none.
+        std::atomic<long long> deadline_;
+    };
+
     //! PNG image.
     class PNGImage
     {
@@ -18,19 +93,32 @@ namespace svg
         //! @param png_file_name File name.
         PNGImage(const std::string &png_file_name);
         //! Constructor of blank image.
-        //! Initally, all pixels will be white.
+        //! Initally, all pixels will be white (RGB, RGBX) or transparent
+        //! (RGBA). Rows of 4-byte formats are padded to 16 bytes.
         //! @param w Image width.
         //! @param h Image height.
-        PNGImage(int w, int h);
+        //! @param format Pixel layout.
+        PNGImage(int w, int h, PixelFormat format = PixelFormat::rgb);
         //! Destructor.
         ~PNGImage();
+        //! Turn into a blank image of another size, reusing the pixel memory
+        //! when it is large enough. The clip box, origin and opacity are
+        //! reset as in a new image.
+        //! @param w Image width.
+        //! @param h Image height.
+        //! @param format Pixel layout.
+        void reset(int w, int h, PixelFormat format);
         //! Get image width.
         //! @return The image width.
         int width() const;
         //! Get image height.
         //! @return The image height.
         int height() const;
+        //! Get the pixel layout.
+        //! @return The pixel format.
+        PixelFormat format() const;
         //! Get mutable reference to image pixel.
+        //! For RGBA images, this is the premultiplied color of the pixel.
         //! @param x X position
         //! @param y Y position.
         //! @return Reference to pixel.
@@ -40,9 +128,25 @@ namespace svg
         //! @param y Y position.
         //! @return Reference to pixel.
         Color at(int x, int y) const;
-        //! Save to output file.
+        //! Get the pixels of a row, left to right. RGB images only.
+        //! @param y Y position.
+        //! @return Pointer to the first of width() pixels.
+        const Color *row(int y) const;
+        //! Save to output file, in the format given by its extension.
+        //! RGBA images are saved with an alpha channel, not premultiplied;
+        //! RGBX images are packed to RGB.
         //! @param png_file_name Output file name.
         void save(const std::string &png_file_name) const;
+        //! Save to output file in a given format.
+        //! RGBA images are saved with an alpha channel, not premultiplied,
+        //! except in PPM which has none: colors are then as if over black.
+        //! @param file_name Output file name.
+        //! @param format File format.
+        void save(const std::string &file_name, ImageFormat format) const;
+        //! Guess the file format from a file name.
+        //! @param file_name File name ending in .ppm, .qoi, .raw or else PNG.
+        //! @return The file format.
+        static ImageFormat format_for(const std::string &file_name);
         //! Draw a line defined by 2 points.
         //! @param a First point.
         //! @param b Second point.
@@ -52,20 +156,161 @@ namespace svg
         //! @param points Vector of points defining the polygon.
         //! @param fill Color to use for the polygon fill.
         void draw_polygon(const std::vector<Point> &points, const Color &fill);
+        //! Draw a polygon.
+        //! @param points Array of points defining the polygon.
+        //! @param n Number of points.
+        //! @param fill Color to use for the polygon fill.
+        void draw_polygon(const Point *points, size_t n, const Color &fill);
+        //! Draw a shape made of several closed contours in one pass.
+        //! @param points Vertices of all contours, one contour after the other.
+        //! @param ends Index one past the last vertex of each contour.
+        //! @param contours Number of contours.
+        //! @param rule Rule deciding which pixels are inside the shape.
+        //! @param fill Color to use for the fill.
+        void draw_polygon(const Point *points, const size_t *ends, size_t contours,
+                          FillRule rule, const Color &fill);
         //! Draw an ellipse.
         //! @param center Coordinates for the ellipse center.
         //! @param radius Radius in X and Y axis.
         //! @param fill Color to use for the ellipse fill.
-        //! @param orientation ellipse orientation.
         void draw_ellipse(const Point &center, const Point &radius, const Color &fill);
+        //! Draw a rotated ellipse, with spans solved from its conic equation.
+        //! @param center Coordinates for the ellipse center.
+        //! @param radius Radius along the ellipse's own X and Y axes.
+        //! @param degrees Clockwise rotation of the axes, in degrees.
+        //! @param fill Color to use for the ellipse fill.
+        void draw_ellipse(const Point &center, const Point &radius, double degrees,
+                          const Color &fill);
+        //! Fill a box with an opaque color, ignoring the clip box and alpha.
+        //! @param box Pixels to fill (clipped to the image).
+        //! @param c Color to use.
+        void fill(const Box &box, const Color &c);
+        //! Restrict all subsequent drawing to a box.
+        //! Initially, drawing is restricted to the whole image.
+        //! @param box Pixels that may be written (clipped to the image).
+        void set_clip(const Box &box);
+        //! Get the box drawing is currently restricted to.
+        //! @return The clip box.
+        Box clip() const;
+        //! Get the drawing coordinates that drawing may currently write,
+        //! i.e. the clip box moved by the origin.
+        //! @return The clip box, in drawing coordinates.
+        Box visible() const;
+        //! Set the drawing coordinates that map to the top-left pixel, so
+        //! the image can hold a region of a larger drawing.
+        //! Initially, the origin is (0, 0).
+        //! @param x X drawing coordinate of pixel (0, 0).
+        //! @param y Y drawing coordinate of pixel (0, 0).
+        void set_origin(int x, int y);
+        //! Set the opacity of all subsequent drawing. Opaque drawing
+        //! overwrites pixels; translucent drawing blends over them.
+        //! Initially, drawing is opaque.
+        //! @param alpha Opacity, from 0 (invisible) to 255 (opaque).
+        void set_alpha(int alpha);
+        //! Get the opacity of drawing.
+        //! @return Opacity, from 0 to 255.
+        int alpha() const;
+        //! Paint all subsequent drawing with a gradient instead of the
+        //! colors passed to drawing operations (except fill).
+        //! @param gradient Gradient, or nullptr to paint with colors again.
+        //! The gradient must outlive its use.
+        //! @param box_min Top-left corner of the bounds of the shape being
+        //! painted, for gradients in bounding box units.
+        //! @param box_max Bottom-right corner of the bounds.
+        void set_gradient(const Gradient *gradient, const Point &box_min = {0, 0},
+                          const Point &box_max = {0, 0});
+        //! Blend an RGBA layer over the image, source over. The layer's
+        //! origin places it in drawing coordinates; only pixels in the clip
+        //! box change.
+        //! @param layer Image to blend, in PixelFormat::rgba.
+        //! @param alpha Opacity of the whole layer, from 0 to 255.
+        void composite(const PNGImage &layer, int alpha);
+        //! Shrink the whole image into another one of the same pixel format,
+        //! each output pixel averaging the pixels it covers. When both sizes
+        //! differ by the same integer factor, this is a plain box filter.
+        //! The clip box, origin and opacity of the output are ignored.
+        //! @param out Output image, with the wanted size.
+        void downscale(PNGImage &out) const;
+        //! Make drawing functions throw Cancelled once a token is
+        //! cancelled. The token must outlive its use by the image.
+        //! @param token The token, or nullptr to never stop.
+        void set_cancel(const CancelToken *token);
+        //! Get the token set by set_cancel.
+        //! @return The token, or nullptr.
+        const CancelToken *cancel_token() const;
+        //! Throw Cancelled if the token set by set_cancel is cancelled.
+        void check_cancel() const;
 
     private:
+        //! Get the pixels as tightly packed rows, RGB or RGBA with straight
+        //! alpha, copying them only when the layout differs.
+        //! @param buffer Receives the pixels when they are copied.
+        //! @param channels Receives 3 or 4.
+        //! @param color_only Drop alpha, keeping premultiplied colors.
+        //! @return The first pixel of the top row.
+        const unsigned char *packed(std::vector<unsigned char> &buffer, int &channels,
+                                    bool color_only) const;
+        //! Shrink by an integer factor in both directions.
+        //! @param out Output image, k times smaller.
+        //! @param k Factor.
+        void downscale_box(PNGImage &out, int k) const;
+        //! Shrink to any size, weighting pixels by the area they share with
+        //! each output pixel.
+        //! @param out Output image.
+        void downscale_area(PNGImage &out) const;
+        //! Set one pixel, if inside the clip box.
+        //! @param x X drawing coordinate.
+        //! @param y Y drawing coordinate.
+        //! @param c Color to use.
+        void plot(int x, int y, const Color &c);
+        //! Set a horizontal run of pixels, clipped to the clip box.
+        //! @param y Row, in drawing coordinates.
+        //! @param x_from First column, in drawing coordinates.
+        //! @param x_to Last column (inclusive).
+        //! @param c Color to use.
+        void fill_span(int y, int x_from, int x_to, const Color &c);
+        //! Paint consecutive pixels with the drawing opacity.
+        //! @param p First byte of the first pixel.
+        //! @param n Number of pixels.
+        //! @param c Color to use.
+        void paint(unsigned char *p, int n, const Color &c);
+        //! Paint consecutive pixels of a row with the gradient.
+        //! @param p First byte of the first pixel.
+        //! @param x X drawing coordinate of the first pixel.
+        //! @param y Y drawing coordinate of the row.
+        //! @param n Number of pixels.
+        void paint_gradient(unsigned char *p, int x, int y, int n);
+
         //! Width.
         int width_;
         //! Height.
         int height_;
-        //! Pixels.
-        Color *pixels_;
+        //! Pixel layout.
+        PixelFormat format_;
+        //! Bytes per pixel.
+        int bpp_;
+        //! Bytes per row.
+        int stride_;
+        //! Pixel bytes, row after row.
+        unsigned char *data_;
+        //! Bytes allocated for data_.
+        size_t capacity_;
+        //! Opacity of drawing.
+        int alpha_;
+        //! Gradient painting, if any, and the bounds it is relative to.
+        const Gradient *gradient_;
+        Point gradient_min_, gradient_max_;
+        //! Token checked while drawing, if any.
+        const CancelToken *cancel_;
+        //! Pixels that drawing operations may write.
+        Box clip_;
+        //! Drawing coordinates of pixel (0, 0).
+        int origin_x_;
+        //! Drawing coordinates of pixel (0, 0).
+        int origin_y_;
+        //! While set, plot records the visible pixels it is given here, as
+        //! (y, x) drawing coordinates, instead of painting them.
+        std::vector<std::pair<int, int>> *plotted_;
     };
 }
 
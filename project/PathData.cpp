@@ -0,0 +1,420 @@
+//! @file PathData.cpp
+#include "PathData.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace svg
+{
+    size_t Contours::size() const
+    {
+        return ends.size();
+    }
+
+    size_t Contours::begin(size_t i) const
+    {
+        return i == 0 ? 0 : ends[i - 1];
+    }
+
+    void Contours::clear()
+    {
+        points.clear();
+        ends.clear();
+        closed.clear();
+    }
+
+    namespace
+    {
+        //! Reads the numbers and flags of path data.
+        class Scanner
+        {
+        public:
+            Scanner(const char *s) : s_(s) {}
+
+            //! Skips whitespace and at most one comma.
+            void skip_separators()
+            {
+                skip_spaces();
+                if (*s_ == ',')
+                {
+                    s_++;
+                    skip_spaces();
+                }
+            }
+            bool at_end()
+            {
+                skip_spaces();
+                return *s_ == '\0';
+            }
+            //! Checks if a number follows (and not a command).
+            bool at_number()
+            {
+                skip_separators();
+                char c = *s_;
+                return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.';
+            }
+            //! Reads a command letter, if one follows.
+            bool command(char &c)
+            {
+                skip_spaces();
+                if ((*s_ >= 'a' && *s_ <= 'z') || (*s_ >= 'A' && *s_ <= 'Z'))
+                {
+                    c = *s_++;
+                    return true;
+                }
+                return false;
+            }
+            bool number(double &v)
+            {
+                if (!at_number())
+                {
+                    return false;
+                }
+                char *end;
+                v = ::strtod(s_, &end);
+                if (end == s_)
+                {
+                    return false;
+                }
+                s_ = end;
+                return true;
+            }
+            //! Reads an arc flag, which may be written without separators.
+            bool flag(bool &f)
+            {
+                skip_separators();
+                if (*s_ != '0' && *s_ != '1')
+                {
+                    return false;
+                }
+                f = *s_++ == '1';
+                return true;
+            }
+
+        private:
+            void skip_spaces()
+            {
+                while (*s_ == ' ' || *s_ == '\t' || *s_ == '\n' || *s_ == '\r' || *s_ == '\f')
+                {
+                    s_++;
+                }
+            }
+            const char *s_;
+        };
+
+        double length(const Point &v)
+        {
+            return std::sqrt(v.x * v.x + v.y * v.y);
+        }
+
+        //! Builds contours from absolute segments.
+        class Flattener
+        {
+        public:
+            Flattener(double tolerance, Contours &out)
+                : tolerance_(std::max(tolerance, 1e-3)), out_(out), open_(false) {}
+
+            void move_to(const Point &p)
+            {
+                finish(false);
+                out_.points.push_back(p);
+                open_ = true;
+            }
+            void line_to(const Point &p)
+            {
+                out_.points.push_back(p);
+            }
+            void quad_to(const Point &p0, const Point &p1, const Point &p2)
+            {
+                // Deviation of a quadratic from its chord is at most
+                // |p0 - 2 p1 + p2| / (4 n^2) for n uniform segments.
+                Point dd = {p0.x - 2 * p1.x + p2.x, p0.y - 2 * p1.y + p2.y};
+                int n = segments(std::sqrt(length(dd) / (4 * tolerance_)));
+                for (int i = 1; i <= n; i++)
+                {
+                    double t = (double)i / n, u = 1 - t;
+                    out_.points.push_back({u * u * p0.x + 2 * u * t * p1.x + t * t * p2.x,
+                                           u * u * p0.y + 2 * u * t * p1.y + t * t * p2.y});
+                }
+            }
+            void cubic_to(const Point &p0, const Point &p1, const Point &p2, const Point &p3)
+            {
+                // Wang's bound for cubics: n = sqrt(3/4 * max|second difference| / tolerance).
+                Point d1 = {p0.x - 2 * p1.x + p2.x, p0.y - 2 * p1.y + p2.y};
+                Point d2 = {p1.x - 2 * p2.x + p3.x, p1.y - 2 * p2.y + p3.y};
+                double dd = std::max(length(d1), length(d2));
+                int n = segments(std::sqrt(0.75 * dd / tolerance_));
+                for (int i = 1; i <= n; i++)
+                {
+                    double t = (double)i / n, u = 1 - t;
+                    double a = u * u * u, b = 3 * u * u * t, c = 3 * u * t * t, d = t * t * t;
+                    out_.points.push_back({a * p0.x + b * p1.x + c * p2.x + d * p3.x,
+                                           a * p0.y + b * p1.y + c * p2.y + d * p3.y});
+                }
+            }
+            //! Elliptical arc, following the endpoint to center conversion
+            //! of the SVG specification (appendix F.6).
+            void arc_to(const Point &p0, double rx, double ry, double degrees,
+                        bool large_arc, bool sweep, const Point &p1)
+            {
+                rx = std::fabs(rx);
+                ry = std::fabs(ry);
+                if (rx == 0 || ry == 0 || (p0.x == p1.x && p0.y == p1.y))
+                {
+                    line_to(p1);
+                    return;
+                }
+                double phi = degrees * M_PI / 180.0;
+                double cp = std::cos(phi), sp = std::sin(phi);
+                double hx = (p0.x - p1.x) / 2, hy = (p0.y - p1.y) / 2;
+                double x1 = cp * hx + sp * hy, y1 = -sp * hx + cp * hy;
+                // Scale radii up if no ellipse can reach both points.
+                double lambda = (x1 * x1) / (rx * rx) + (y1 * y1) / (ry * ry);
+                if (lambda > 1)
+                {
+                    rx *= std::sqrt(lambda);
+                    ry *= std::sqrt(lambda);
+                }
+                double num = rx * rx * ry * ry - rx * rx * y1 * y1 - ry * ry * x1 * x1;
+                double den = rx * rx * y1 * y1 + ry * ry * x1 * x1;
+                double k = std::sqrt(std::max(0.0, num / den));
+                if (large_arc == sweep)
+                {
+                    k = -k;
+                }
+                double cx1 = k * rx * y1 / ry, cy1 = -k * ry * x1 / rx;
+                double cx = cp * cx1 - sp * cy1 + (p0.x + p1.x) / 2;
+                double cy = sp * cx1 + cp * cy1 + (p0.y + p1.y) / 2;
+                double theta = std::atan2((y1 - cy1) / ry, (x1 - cx1) / rx);
+                double delta = std::atan2((-y1 - cy1) / ry, (-x1 - cx1) / rx) - theta;
+                if (sweep && delta < 0)
+                {
+                    delta += 2 * M_PI;
+                }
+                else if (!sweep && delta > 0)
+                {
+                    delta -= 2 * M_PI;
+                }
+                // Angle step that keeps the sagitta within the tolerance.
+                double r = std::max(rx, ry);
+                double step = 2 * std::acos(std::max(-1.0, 1 - tolerance_ / r));
+                int n = segments(std::fabs(delta) / step);
+                for (int i = 1; i < n; i++)
+                {
+                    double a = theta + delta * i / n;
+                    double ex = rx * std::cos(a), ey = ry * std::sin(a);
+                    out_.points.push_back({cp * ex - sp * ey + cx, sp * ex + cp * ey + cy});
+                }
+                out_.points.push_back(p1);
+            }
+            //! Ends the current contour.
+            void finish(bool closed)
+            {
+                if (!open_)
+                {
+                    return;
+                }
+                out_.ends.push_back(out_.points.size());
+                out_.closed.push_back(closed);
+                open_ = false;
+            }
+            bool open() const
+            {
+                return open_;
+            }
+
+        private:
+            static int segments(double n)
+            {
+                return (int)std::min(std::max(std::ceil(n), 1.0), 10000.0);
+            }
+            double tolerance_;
+            Contours &out_;
+            bool open_;
+        };
+    }
+
+    bool parse_path(const char *d, double tolerance, Contours &out)
+    {
+        if (d == nullptr)
+        {
+            return true; // no path data: nothing to draw
+        }
+        Scanner in(d);
+        Flattener flat(tolerance, out);
+        Point current = {0, 0}, start = {0, 0};
+        // Last control point, for the reflections of S and T.
+        Point control = {0, 0};
+        char previous = ' ';
+        char cmd = ' ';
+
+        while (!in.at_end())
+        {
+            char c;
+            if (in.command(c))
+            {
+                cmd = c;
+            }
+            else if (cmd == ' ' || cmd == 'Z' || cmd == 'z')
+            {
+                break; // numbers without a command
+            }
+            else if (cmd == 'M')
+            {
+                cmd = 'L'; // extra pairs after a moveto are linetos
+            }
+            else if (cmd == 'm')
+            {
+                cmd = 'l';
+            }
+            bool relative = cmd >= 'a' && cmd <= 'z';
+            Point base = relative ? current : Point{0, 0};
+            char upper = relative ? (char)(cmd - 'a' + 'A') : cmd;
+            if (upper != 'M' && upper != 'Z' && !flat.open())
+            {
+                if (previous == ' ')
+                {
+                    break; // path data must begin with a moveto
+                }
+                flat.move_to(current); // drawing after Z starts a new contour
+            }
+            bool ok = true;
+            switch (upper)
+            {
+            case 'M':
+            {
+                Point p;
+                ok = in.number(p.x) && in.number(p.y);
+                if (ok)
+                {
+                    current = start = p.translate(base);
+                    flat.move_to(current);
+                }
+                break;
+            }
+            case 'L':
+            {
+                Point p;
+                ok = in.number(p.x) && in.number(p.y);
+                if (ok)
+                {
+                    current = p.translate(base);
+                    flat.line_to(current);
+                }
+                break;
+            }
+            case 'H':
+            {
+                double x;
+                ok = in.number(x);
+                if (ok)
+                {
+                    current.x = relative ? current.x + x : x;
+                    flat.line_to(current);
+                }
+                break;
+            }
+            case 'V':
+            {
+                double y;
+                ok = in.number(y);
+                if (ok)
+                {
+                    current.y = relative ? current.y + y : y;
+                    flat.line_to(current);
+                }
+                break;
+            }
+            case 'C':
+            case 'S':
+            {
+                Point p1, p2, p3;
+                if (upper == 'C')
+                {
+                    ok = in.number(p1.x) && in.number(p1.y);
+                    if (ok)
+                    {
+                        p1 = p1.translate(base);
+                    }
+                }
+                else
+                {
+                    bool smooth = previous == 'C' || previous == 'S';
+                    p1 = smooth ? Point{2 * current.x - control.x, 2 * current.y - control.y}
+                                : current;
+                }
+                ok = ok && in.number(p2.x) && in.number(p2.y) && in.number(p3.x) && in.number(p3.y);
+                if (ok)
+                {
+                    p2 = p2.translate(base);
+                    p3 = p3.translate(base);
+                    flat.cubic_to(current, p1, p2, p3);
+                    control = p2;
+                    current = p3;
+                }
+                break;
+            }
+            case 'Q':
+            case 'T':
+            {
+                Point p1, p2;
+                if (upper == 'Q')
+                {
+                    ok = in.number(p1.x) && in.number(p1.y);
+                    if (ok)
+                    {
+                        p1 = p1.translate(base);
+                    }
+                }
+                else
+                {
+                    bool smooth = previous == 'Q' || previous == 'T';
+                    p1 = smooth ? Point{2 * current.x - control.x, 2 * current.y - control.y}
+                                : current;
+                }
+                ok = ok && in.number(p2.x) && in.number(p2.y);
+                if (ok)
+                {
+                    p2 = p2.translate(base);
+                    flat.quad_to(current, p1, p2);
+                    control = p1;
+                    current = p2;
+                }
+                break;
+            }
+            case 'A':
+            {
+                double rx, ry, angle;
+                bool large_arc, sweep;
+                Point p;
+                ok = in.number(rx) && in.number(ry) && in.number(angle) &&
+                     in.flag(large_arc) && in.flag(sweep) &&
+                     in.number(p.x) && in.number(p.y);
+                if (ok)
+                {
+                    p = p.translate(base);
+                    flat.arc_to(current, rx, ry, angle, large_arc, sweep, p);
+                    current = p;
+                }
+                break;
+            }
+            case 'Z':
+                flat.finish(true);
+                current = start;
+                break;
+            default:
+                ok = false;
+                break;
+            }
+            if (!ok)
+            {
+                flat.finish(false);
+                return false;
+            }
+            previous = upper;
+        }
+        flat.finish(false);
+        return previous != ' ' || *d == '\0';
+    }
+}
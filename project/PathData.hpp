@@ -0,0 +1,49 @@
+//! @file PathData.hpp
+#ifndef __svg_PathData_hpp__
+#define __svg_PathData_hpp__
+
+#include "Point.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace svg
+{
+    //! Default maximum distance, in pixels, between a curve and the
+    //! line segments that approximate it.
+    const double DEFAULT_FLATTENING_TOLERANCE = 0.25;
+
+    //! Polygonal contours (subpaths) sharing one vertex vector, so that
+    //! building them does not allocate per segment or per subpath.
+    struct Contours
+    {
+        //! Vertices of all contours, one contour after the other.
+        std::vector<Point> points;
+        //! Index one past the last vertex of each contour.
+        std::vector<size_t> ends;
+        //! Whether each contour was closed with a 'Z' command.
+        std::vector<bool> closed;
+
+        //! Get the number of contours.
+        //! @return The number of contours.
+        size_t size() const;
+        //! Get the first vertex of a contour.
+        //! @param i Contour index.
+        //! @return Index of the contour's first vertex in points.
+        size_t begin(size_t i) const;
+        //! Remove all contours.
+        void clear();
+    };
+
+    //! Parse SVG path data (the 'd' attribute) and flatten it into contours.
+    //! All commands (M, L, H, V, C, S, Q, T, A, Z), absolute and relative,
+    //! are supported. Curves and arcs are split into the fewest segments
+    //! that keep within the tolerance. As SVG requires, parsing stops at
+    //! the first error and the path up to that point is kept.
+    //! @param d Path data.
+    //! @param tolerance Maximum distance between curves and segments.
+    //! @param out Receives the contours (appended to any existing ones).
+    //! @return true if the whole path data was valid.
+    bool parse_path(const char *d, double tolerance, Contours &out);
+}
+#endif
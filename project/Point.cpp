@@ -1,7 +1,15 @@
 //! @file point.cpp
+#include <algorithm>
 #include <cmath>
 #include "Point.hpp"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
 namespace svg
 {
     Point Point::translate(const Point &t) const
@@ -9,22 +17,150 @@ namespace svg
         return {x + t.x, y + t.y};
     }
 
-    Point Point::rotate(const Point &origin, int degrees) const
+    Point Point::rotate(const Point &origin, double degrees) const
     {
         double angle = M_PI * degrees / 180.0;
         double dx = x - origin.x;
         double dy = y - origin.y;
         double s = ::sin(angle);
         double c = ::cos(angle);
-        int rx = (int)::lround(c * dx - s * dy);
-        int ry = (int)::lround(s * dx + c * dy);
-        return {origin.x + rx, origin.y + ry};
+        return {origin.x + (c * dx - s * dy), origin.y + (s * dx + c * dy)};
     }
 
-    Point Point::scale(const Point &origin, int v) const
+    Point Point::scale(const Point &origin, double v) const
     {
         return {origin.x + (x - origin.x) * v,
                 origin.y + (y - origin.y) * v};
     }
 
+    Box Box::around(const Point *from, const Point *to)
+    {
+        if (from == to)
+        {
+            return EMPTY_BOX;
+        }
+        double x_min = from->x, x_max = from->x, y_min = from->y, y_max = from->y;
+        for (const Point *p = from + 1; p != to; p++)
+        {
+            x_min = std::min(x_min, p->x);
+            x_max = std::max(x_max, p->x);
+            y_min = std::min(y_min, p->y);
+            y_max = std::max(y_max, p->y);
+        }
+        return {(int)::floor(x_min), (int)::floor(y_min),
+                (int)::ceil(x_max), (int)::ceil(y_max)};
+    }
+
+    bool Box::empty() const
+    {
+        return x_min > x_max || y_min > y_max;
+    }
+
+    bool Box::intersects(const Box &o) const
+    {
+        return !intersect(o).empty();
+    }
+
+    Box Box::intersect(const Box &o) const
+    {
+        return {std::max(x_min, o.x_min), std::max(y_min, o.y_min),
+                std::min(x_max, o.x_max), std::min(y_max, o.y_max)};
+    }
+
+    Box Box::unite(const Box &o) const
+    {
+        if (empty())
+        {
+            return o;
+        }
+        if (o.empty())
+        {
+            return *this;
+        }
+        return {std::min(x_min, o.x_min), std::min(y_min, o.y_min),
+                std::max(x_max, o.x_max), std::max(y_max, o.y_max)};
+    }
+
+    Box Box::grow(int d) const
+    {
+        if (empty())
+        {
+            return *this;
+        }
+        return {x_min - d, y_min - d, x_max + d, y_max + d};
+    }
+
+    //! Applies x' = m[0] x + m[2] y + m[4], y' = m[1] x + m[3] y + m[5]
+    //! to n points. A Point is two packed doubles, so each point fills an
+    //! SSE2 register as is and no structure-of-arrays copy is needed.
+    static void transform_points(Point *p, size_t n, const double m[6])
+    {
+        size_t i = 0;
+#if defined(__AVX__)
+        // Two points per 256-bit register: [x0 y0 x1 y1].
+        __m256d col_x4 = _mm256_setr_pd(m[0], m[1], m[0], m[1]);
+        __m256d col_y4 = _mm256_setr_pd(m[2], m[3], m[2], m[3]);
+        __m256d offset4 = _mm256_setr_pd(m[4], m[5], m[4], m[5]);
+        for (; i + 2 <= n; i += 2)
+        {
+            double *d = &p[i].x;
+            __m256d v = _mm256_loadu_pd(d);
+            __m256d xx = _mm256_movedup_pd(v);
+            __m256d yy = _mm256_permute_pd(v, 0xF);
+            __m256d r = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(col_x4, xx),
+                                                    _mm256_mul_pd(col_y4, yy)),
+                                      offset4);
+            _mm256_storeu_pd(d, r);
+        }
+#endif
+#if defined(__SSE2__)
+        __m128d col_x = _mm_setr_pd(m[0], m[1]);
+        __m128d col_y = _mm_setr_pd(m[2], m[3]);
+        __m128d offset = _mm_setr_pd(m[4], m[5]);
+        for (; i < n; i++)
+        {
+            double *d = &p[i].x;
+            __m128d v = _mm_loadu_pd(d);
+            __m128d xx = _mm_unpacklo_pd(v, v);
+            __m128d yy = _mm_unpackhi_pd(v, v);
+            __m128d r = _mm_add_pd(_mm_add_pd(_mm_mul_pd(col_x, xx),
+                                              _mm_mul_pd(col_y, yy)),
+                                   offset);
+            _mm_storeu_pd(d, r);
+        }
+#endif
+        for (; i < n; i++)
+        {
+            double x = p[i].x, y = p[i].y;
+            p[i].x = m[0] * x + m[2] * y + m[4];
+            p[i].y = m[1] * x + m[3] * y + m[5];
+        }
+    }
+
+    void translate_points(std::vector<Point> &points, const Point &t)
+    {
+        const double m[6] = {1, 0, 0, 1, t.x, t.y};
+        transform_points(points.data(), points.size(), m);
+    }
+
+    void rotate_points(std::vector<Point> &points, const Point &origin, double degrees)
+    {
+        double angle = M_PI * degrees / 180.0;
+        double s = ::sin(angle);
+        double c = ::cos(angle);
+        // origin + R (p - origin)
+        const double m[6] = {c, s, -s, c,
+                             origin.x - c * origin.x + s * origin.y,
+                             origin.y - s * origin.x - c * origin.y};
+        transform_points(points.data(), points.size(), m);
+    }
+
+    void scale_points(std::vector<Point> &points, const Point &origin, double v)
+    {
+        const double m[6] = {v, 0, 0, v,
+                             origin.x - v * origin.x,
+                             origin.y - v * origin.y};
+        transform_points(points.data(), points.size(), m);
+    }
+
 }
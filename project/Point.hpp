@@ -2,15 +2,19 @@
 #ifndef __svg_point_hpp__
 #define __svg_point_hpp__
 
+#include <vector>
+
 namespace svg
 {
     //! 2D Point struct, with a few convenience member functions (can be defined for structs too).
+    //! Coordinates are kept with sub-pixel precision; they are only rounded
+    //! to pixels by the rasterizers in PNGImage.
     struct Point
     {
         //! X coordinate.
-        int x;
+        double x;
         //! Y coordinate.
-        int y;
+        double y;
 
         //! Translate a point.
         //! @param t translation direction.
@@ -20,12 +24,70 @@ namespace svg
         //! @param origin Rotation origin
         //! @param degrees Degrees of rotation.
         //! @return Rotation result.
-        Point rotate(const Point &origin, int degrees) const;
+        Point rotate(const Point &origin, double degrees) const;
         //! Scale a point.
         //! @param origin Scaling origin.
         //! @param v Scale amount.
         //! @return Scaling result.
-        Point scale(const Point &origin, int v) const;
+        Point scale(const Point &origin, double v) const;
     };
+
+    //! Axis-aligned box of pixels, both ends inclusive.
+    struct Box
+    {
+        //! Leftmost column.
+        int x_min;
+        //! Topmost row.
+        int y_min;
+        //! Rightmost column.
+        int x_max;
+        //! Bottom row.
+        int y_max;
+
+        //! Smallest box of pixels that may be touched by points in a range.
+        //! @param from First point.
+        //! @param to One past the last point.
+        //! @return The box, or an empty box if the range is empty.
+        static Box around(const Point *from, const Point *to);
+        //! Check if the box has no pixels.
+        //! @return true if the box is empty.
+        bool empty() const;
+        //! Check if two boxes share at least one pixel.
+        //! @param o Other box.
+        //! @return true if the boxes intersect.
+        bool intersects(const Box &o) const;
+        //! Intersect two boxes.
+        //! @param o Other box.
+        //! @return The pixels in both boxes (possibly empty).
+        Box intersect(const Box &o) const;
+        //! Unite two boxes.
+        //! @param o Other box.
+        //! @return Smallest box holding both boxes.
+        Box unite(const Box &o) const;
+        //! Grow a box on all sides.
+        //! @param d Pixels to add on each side.
+        //! @return The grown box (an empty box stays empty).
+        Box grow(int d) const;
+    };
+
+    //! A box with no pixels, the identity of Box::unite.
+    const Box EMPTY_BOX = {0, 0, -1, -1};
+
+    //! Translate all points of a vector.
+    //! @param points Points to transform in place.
+    //! @param t translation direction.
+    void translate_points(std::vector<Point> &points, const Point &t);
+    //! Rotate all points of a vector.
+    //! Unlike calling Point::rotate per point, the sine and cosine are
+    //! computed once and the points are transformed with SIMD.
+    //! @param points Points to transform in place.
+    //! @param origin Rotation origin
+    //! @param degrees Degrees of rotation.
+    void rotate_points(std::vector<Point> &points, const Point &origin, double degrees);
+    //! Scale all points of a vector.
+    //! @param points Points to transform in place.
+    //! @param origin Scaling origin.
+    //! @param v Scale amount.
+    void scale_points(std::vector<Point> &points, const Point &origin, double v);
 }
 #endif
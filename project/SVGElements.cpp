@@ -1,9 +1,142 @@
 #include "SVGElements.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
 namespace svg {
 
+//! Applies a transform string (translate, rotate and/or scale) to points
+static void transformPoints(const string &transform, Point origin,
+                            vector<Point> &points) {
+    //! Translate
+    if (transform.find("translate") != string::npos) {
+        Point translate = {
+            stod(transform.substr(transform.find("(") + 1,
+                                  transform.find_first_of(" ,") -
+                                      transform.find("(") - 1)),
+            stod(transform.substr(transform.find_first_of(", ") + 1,
+                                  transform.find(")") -
+                                      transform.find_first_of(" ,") - 1))};
+        translate_points(points, translate);
+    }
+    //! Rotate
+    if (transform.find("rotate") != string::npos) {
+        double r_angle = stod(
+            transform.substr(transform.find("(") + 1,
+                             transform.find(")") - transform.find("(") - 1));
+        rotate_points(points, origin, r_angle);
+    }
+    //! Scale
+    if (transform.find("scale") != string::npos) {
+        double scale_factor = stod(
+            transform.substr(transform.find("(") + 1,
+                             transform.find(")") - transform.find("(") - 1));
+        scale_points(points, origin, scale_factor);
+    }
+}
+
+//! Moves a gradient in user space along with the shape it paints; gradients
+//! in bounding box units follow the shape's bounds already
+static void transformGradient(shared_ptr<const Gradient> &gradient,
+                              const string &transform, Point origin) {
+    if (gradient == nullptr ||
+        gradient->units() != GradientUnits::user_space) {
+        return;
+    }
+    vector<Point> points = gradient->points();
+    transformPoints(transform, origin, points);
+    shared_ptr<Gradient> moved = make_shared<Gradient>(*gradient);
+    moved->set_points(points);
+    gradient = moved;
+}
+
+//! Makes the image paint with a gradient, if any, relative to the bounds
+//! of the given points
+static void useGradient(PNGImage &img, const Gradient *gradient,
+                        const Point *from, const Point *to) {
+    if (gradient == nullptr || from == to) {
+        img.set_gradient(nullptr);
+        return;
+    }
+    Point lo = *from, hi = *from;
+    for (const Point *p = from + 1; p != to; p++) {
+        lo = {std::min(lo.x, p->x), std::min(lo.y, p->y)};
+        hi = {std::max(hi.x, p->x), std::max(hi.y, p->y)};
+    }
+    img.set_gradient(gradient, lo, hi);
+}
+
+//! Outline of thick strokes, reused across draws to avoid allocations
+static thread_local Contours stroke_outline;
+
+//! Empties the outline before a shape gathers its stroke, so that a draw
+//! interrupted by an exception leaves nothing behind for the next shape
+static void beginStroke() { stroke_outline.clear(); }
+
+//! Adds the stroke of a contour to the outline, or draws it directly if it
+//! is a hairline
+static void strokeContour(PNGImage &img, const Point *points, size_t n,
+                          bool closed, const StrokeStyle &style,
+                          const Color &color) {
+    if (!is_stroked(style)) {
+        return;
+    }
+    if (!is_hairline(style)) {
+        stroke_contour(points, n, closed, style, DEFAULT_FLATTENING_TOLERANCE,
+                       stroke_outline);
+        return;
+    }
+    for (size_t i = 0; i + 1 < n; i++) {
+        img.draw_line(points[i], points[i + 1], color);
+    }
+    if (closed && n > 1) {
+        img.draw_line(points[n - 1], points[0], color);
+    }
+}
+
+//! Fills the outline gathered by strokeContour in a single pass
+static void fillStroke(PNGImage &img, const Color &color) {
+    if (stroke_outline.size() == 0) {
+        return;
+    }
+    img.draw_polygon(stroke_outline.points.data(), stroke_outline.ends.data(),
+                     stroke_outline.size(), FillRule::nonzero, color);
+    stroke_outline.clear();
+}
+
+//! Scales an opacity from 0 to 255 by a factor from 0 to 1
+static int fade(int alpha, double opacity) {
+    return (int)lround(alpha * std::max(0.0, std::min(1.0, opacity)));
+}
+
+//! Scratch RGBA layers for translucent groups, kept once released so that
+//! later groups reuse their memory
+static thread_local vector<unique_ptr<PNGImage>> layer_pool;
+
+//! Takes a blank layer from the pool, covering a box in drawing coordinates
+static unique_ptr<PNGImage> acquireLayer(const Box &box) {
+    int w = box.x_max - box.x_min + 1, h = box.y_max - box.y_min + 1;
+    unique_ptr<PNGImage> layer;
+    if (layer_pool.empty()) {
+        layer.reset(new PNGImage(w, h, PixelFormat::rgba));
+    } else {
+        layer = move(layer_pool.back());
+        layer_pool.pop_back();
+        layer->reset(w, h, PixelFormat::rgba);
+    }
+    layer->set_origin(box.x_min, box.y_min);
+    return layer;
+}
+
+//! Returns a layer to the pool
+static void releaseLayer(unique_ptr<PNGImage> layer) {
+    layer_pool.push_back(move(layer));
+}
+
 //! Constructor for the Group class.
 Group::Group(const std::vector<SVGElement *> &elements) {
     for (SVGElement *element : elements) {
@@ -13,9 +146,24 @@ Group::Group(const std::vector<SVGElement *> &elements) {
 
 //! Draw function for the Group class.
 void Group::draw(PNGImage &img) const {
+    if (alpha == 255) {
+        for (SVGElement *element : elements) {
+            element->draw(img);
+        }
+        return;
+    }
+    //! Only the part of the group that can show needs a layer
+    Box box = bounds().intersect(img.visible());
+    if (alpha == 0 || box.empty()) {
+        return;
+    }
+    unique_ptr<PNGImage> layer = acquireLayer(box);
+    layer->set_cancel(img.cancel_token());
     for (SVGElement *element : elements) {
-        element->draw(img);
+        element->draw(*layer);
     }
+    img.composite(*layer, alpha);
+    releaseLayer(move(layer));
 }
 
 //! Transform function for the Group class.
@@ -31,7 +179,55 @@ SVGElement *Group::clone() const {
     for (SVGElement *element : elements) {
         cloned_elements.push_back(element->clone());
     }
-    return new Group(cloned_elements);
+    Group *group = new Group(cloned_elements);
+    group->alpha = alpha;
+    return group;
+}
+
+//! Measure function for the Group class.
+void Group::measure(size_t &elements, size_t &vertices) const {
+    elements++;
+    for (SVGElement *element : this->elements) {
+        element->measure(elements, vertices);
+    }
+}
+
+//! Parts function for the Group class.
+void Group::parts(vector<const SVGElement *> &parts) const {
+    if (alpha != 255) {
+        parts.push_back(this);
+        return;
+    }
+    for (const SVGElement *element : elements) {
+        element->parts(parts);
+    }
+}
+
+//! Bounds function for the Group class.
+Box Group::bounds() const {
+    Box box = EMPTY_BOX;
+    for (SVGElement *element : elements) {
+        box = box.unite(element->bounds());
+    }
+    return box;
+}
+
+//! Set color function for the Group class.
+void Group::set_color(const Color &color) {
+    for (SVGElement *element : elements) {
+        element->set_color(color);
+    }
+}
+
+//! Apply opacity function for the Group class.
+void Group::apply_opacity(double opacity, double fill_opacity,
+                          double stroke_opacity) {
+    alpha = fade(alpha, opacity);
+    if (fill_opacity != 1 || stroke_opacity != 1) {
+        for (SVGElement *element : elements) {
+            element->apply_opacity(1, fill_opacity, stroke_opacity);
+        }
+    }
 }
 
 //! Destructor for the Group class.
@@ -58,150 +254,457 @@ void Use::transform(string transform, Point origin) {
 //! Clone function for the Use class.
 SVGElement *Use::clone() const { return new Use(element); }
 
+//! Measure function for the Use class.
+void Use::measure(size_t &elements, size_t &vertices) const {
+    elements++;
+    element->measure(elements, vertices);
+}
+
+//! Parts function for the Use class.
+void Use::parts(vector<const SVGElement *> &parts) const {
+    element->parts(parts);
+}
+
+//! Bounds function for the Use class.
+Box Use::bounds() const { return element->bounds(); }
+
+//! Set color function for the Use class.
+void Use::set_color(const Color &color) { element->set_color(color); }
+
+//! Apply opacity function for the Use class.
+void Use::apply_opacity(double opacity, double fill_opacity,
+                        double stroke_opacity) {
+    element->apply_opacity(opacity, fill_opacity, stroke_opacity);
+}
+
 //! Default constructor for the SVGElement class.
 SVGElement::SVGElement() {}
 
 //! Destructor for the SVGElement class.
 SVGElement::~SVGElement() {}
 
+//! Default set points function, for elements that have no points.
+void SVGElement::set_points(const vector<Point> &points) {
+    throw runtime_error("Element has no points");
+}
+
+//! Default parts function: the element is its own single part.
+void SVGElement::parts(vector<const SVGElement *> &parts) const {
+    parts.push_back(this);
+}
+
+//! Default apply opacity function, for elements that paint nothing.
+void SVGElement::apply_opacity(double opacity, double fill_opacity,
+                               double stroke_opacity) {}
+
+//! Default set gradients function, for elements that paint nothing.
+void SVGElement::set_gradients(const shared_ptr<const Gradient> &fill,
+                               const shared_ptr<const Gradient> &stroke) {}
+
+//! Default measure function, for elements without vertices.
+void SVGElement::measure(size_t &elements, size_t &vertices) const {
+    elements++;
+}
+
 //! Constructor for the Ellipse class.
-Ellipse::Ellipse(const Color &fill, const Point &center, const Point &radius)
-    : fill(fill), center(center), radius(radius) {}
+Ellipse::Ellipse(const Color &fill, const Point &center, const Point &radius,
+                 bool filled)
+    : fill(fill), center(center), radius(radius), filled(filled) {}
 
 //! Draw function for the Ellipse class.
 void Ellipse::draw(PNGImage &img) const {
-    img.draw_ellipse(center, radius, fill);
+    if (!filled) {
+        return;
+    }
+    Point e = extent();
+    Point corners[2] = {center.translate({-e.x, -e.y}),
+                        center.translate({e.x, e.y})};
+    useGradient(img, fill_gradient.get(), corners, corners + 2);
+    img.set_alpha(fill_alpha);
+    img.draw_ellipse(center, radius, angle, fill);
+    img.set_alpha(255);
+    img.set_gradient(nullptr);
 }
 
 //! Transform function for the Ellipse class.
 void Ellipse::transform(string transform, Point origin) {
     Point translate;
-    int r_angle;
-    int scale_factor;
+    double r_angle;
+    double scale_factor;
 
     if (transform.find("translate") != string::npos) {
         translate = {
-            stoi(transform.substr(transform.find("(") + 1,
+            stod(transform.substr(transform.find("(") + 1,
                                   transform.find_first_of(" ,") -
                                       transform.find("(") - 1)),
-            stoi(transform.substr(transform.find_first_of(", ") + 1,
+            stod(transform.substr(transform.find_first_of(", ") + 1,
                                   transform.find(")") -
                                       transform.find_first_of(", ") - 1))};
         center = center.translate(translate);
     }
     if (transform.find("rotate") != string::npos) {
-        r_angle = stoi(
+        r_angle = stod(
             transform.substr(transform.find("(") + 1,
                              transform.find(")") - transform.find("(") - 1));
         center = center.rotate(origin, r_angle);
+        angle += r_angle;
     }
     if (transform.find("scale") != string::npos) {
-        scale_factor = stoi(
+        scale_factor = stod(
             transform.substr(transform.find("(") + 1,
                              transform.find(")") - transform.find("(") - 1));
         radius = radius.scale({0, 0}, scale_factor);
         center = center.scale(origin, scale_factor);
     }
+    transformGradient(fill_gradient, transform, origin);
 }
 
 //! Clone function for the Ellipse class.
-SVGElement *Ellipse::clone() const { return new Ellipse(fill, center, radius); }
+SVGElement *Ellipse::clone() const { return new Ellipse(*this); }
+
+//! Bounds function for the Ellipse class.
+Box Ellipse::bounds() const {
+    if (!filled) {
+        return EMPTY_BOX;
+    }
+    Point e = extent();
+    Point corners[2] = {center.translate({-e.x, -e.y}),
+                        center.translate({e.x, e.y})};
+    // The rasterizer rounds the center and radii separately, which may
+    // reach one pixel further.
+    return Box::around(corners, corners + 2).grow(1);
+}
+
+//! Extent function for the Ellipse class.
+Point Ellipse::extent() const {
+    if (fmod(angle, 180) == 0) {
+        return radius;
+    }
+    double a = M_PI * angle / 180, s = sin(a), c = cos(a);
+    return {sqrt(radius.x * radius.x * c * c + radius.y * radius.y * s * s),
+            sqrt(radius.x * radius.x * s * s + radius.y * radius.y * c * c)};
+}
+
+//! Set color function for the Ellipse class.
+void Ellipse::set_color(const Color &color) { fill = color; }
+
+//! Apply opacity function for the Ellipse class.
+void Ellipse::apply_opacity(double opacity, double fill_opacity,
+                            double stroke_opacity) {
+    fill_alpha = fade(fill_alpha, opacity * fill_opacity);
+}
+
+//! Set gradients function for the Ellipse class.
+void Ellipse::set_gradients(const shared_ptr<const Gradient> &fill,
+                            const shared_ptr<const Gradient> &stroke) {
+    fill_gradient = fill;
+}
 
 //! Constructor for the Polygon class.
-Polygon::Polygon(const Color &fill, const std::vector<Point> &points)
-    : fill(fill), points(points) {}
+Polygon::Polygon(const Color &fill, const std::vector<Point> &points,
+                 FillRule rule, bool stroked, const Color &stroke,
+                 const StrokeStyle &style, bool filled)
+    : fill(fill), points(points), rule(rule), filled(filled), stroked(stroked),
+      stroke(stroke), style(style) {}
 
 //! Draw function for the Polygon class.
-void Polygon::draw(PNGImage &img) const { img.draw_polygon(points, fill); }
+void Polygon::draw(PNGImage &img) const {
+    size_t n = points.size();
+    const Point *p = points.data();
+    if (filled) {
+        useGradient(img, fill_gradient.get(), p, p + n);
+        img.set_alpha(fill_alpha);
+        img.draw_polygon(p, &n, 1, rule, fill);
+    }
+    if (stroked) {
+        useGradient(img, stroke_gradient.get(), p, p + n);
+        img.set_alpha(stroke_alpha);
+        beginStroke();
+        strokeContour(img, p, n, true, style, stroke);
+        fillStroke(img, stroke);
+    }
+    img.set_alpha(255);
+    img.set_gradient(nullptr);
+}
 
 //! Transform function for the Polygon class.
 void Polygon::transform(string transform, Point origin) {
-    Point translate;
-    int r_angle;
-    int scale_factor;
-    //! Translate
-    if (transform.find("translate") != string::npos) {
-        translate = {
-            stoi(transform.substr(transform.find("(") + 1,
-                                  transform.find_first_of(" ,") -
-                                      transform.find("(") - 1)),
-            stoi(transform.substr(transform.find_first_of(", ") + 1,
-                                  transform.find(")") -
-                                      transform.find_first_of(" ,") - 1))};
-        for (Point &p : points) {
-            p = p.translate(translate);
-        }
-    }
-    //! Rotate
-    if (transform.find("rotate") != string::npos) {
-        r_angle = stoi(
-            transform.substr(transform.find("(") + 1,
-                             transform.find(")") - transform.find("(") - 1));
-        for (Point &p : points) {
-            p = p.rotate(origin, r_angle);
-        }
+    transformPoints(transform, origin, points);
+    transformGradient(fill_gradient, transform, origin);
+    transformGradient(stroke_gradient, transform, origin);
+}
+
+//! Clone function for the Polygon class.
+SVGElement *Polygon::clone() const { return new Polygon(*this); }
+
+//! Measure function for the Polygon class.
+void Polygon::measure(size_t &elements, size_t &vertices) const {
+    elements++;
+    vertices += points.size();
+}
+
+//! Bounds function for the Polygon class.
+Box Polygon::bounds() const {
+    if (!filled && !stroked) {
+        return EMPTY_BOX;
     }
-    //! Scale
-    if (transform.find("scale") != string::npos) {
-        scale_factor = stoi(
-            transform.substr(transform.find("(") + 1,
-                             transform.find(")") - transform.find("(") - 1));
-        for (Point &p : points) {
-            p = p.scale(origin, scale_factor);
-        }
+    Box box = Box::around(points.data(), points.data() + points.size());
+    return stroked ? box.grow(stroke_extent(style)) : box;
+}
+
+//! Set color function for the Polygon class.
+void Polygon::set_color(const Color &color) {
+    if (filled || !stroked) {
+        fill = color;
+    } else {
+        stroke = color;
     }
 }
 
-//! Clone function for the Polygon class.
-SVGElement *Polygon::clone() const { return new Polygon(fill, points); }
+//! Set points function for the Polygon class.
+void Polygon::set_points(const vector<Point> &points) {
+    this->points = points;
+}
+
+//! Apply opacity function for the Polygon class.
+void Polygon::apply_opacity(double opacity, double fill_opacity,
+                            double stroke_opacity) {
+    fill_alpha = fade(fill_alpha, opacity * fill_opacity);
+    stroke_alpha = fade(stroke_alpha, opacity * stroke_opacity);
+}
+
+//! Set gradients function for the Polygon class.
+void Polygon::set_gradients(const shared_ptr<const Gradient> &fill,
+                            const shared_ptr<const Gradient> &stroke) {
+    fill_gradient = fill;
+    stroke_gradient = stroke;
+}
 
 //! Constructor for the Polyline class.
-Polyline::Polyline(const Color &stroke, const std::vector<Point> &points)
-    : stroke(stroke), points(points) {}
+Polyline::Polyline(const Color &stroke, const std::vector<Point> &points,
+                   const StrokeStyle &style, bool stroked)
+    : stroke(stroke), points(points), style(style), stroked(stroked) {}
 
 //! Draw function for the Polyline class.
 void Polyline::draw(PNGImage &img) const {
-    for (size_t i = 0; i < points.size() - 1; i++) {
-        img.draw_line(points[i], points[i + 1], stroke);
+    if (!stroked) {
+        return;
     }
+    const Point *p = points.data();
+    useGradient(img, stroke_gradient.get(), p, p + points.size());
+    img.set_alpha(stroke_alpha);
+    beginStroke();
+    strokeContour(img, p, points.size(), false, style, stroke);
+    fillStroke(img, stroke);
+    img.set_alpha(255);
+    img.set_gradient(nullptr);
 }
 
 //! Transform function for the Polyline class.
 void Polyline::transform(string transform, Point origin) {
-    Point translate;
-    int r_angle;
-    int scale_factor;
-    if (transform.find("translate") != string::npos) {
-        translate = {
-            stoi(transform.substr(transform.find("(") + 1,
-                                  transform.find_first_of(", ") -
-                                      transform.find("(") - 1)),
-            stoi(transform.substr(transform.find_first_of(", ") + 1,
-                                  transform.find(")") -
-                                      transform.find_first_of(", ") - 1))};
-        for (Point &p : points) {
-            p = p.translate(translate);
-        }
+    transformPoints(transform, origin, points);
+    transformGradient(stroke_gradient, transform, origin);
+}
+
+//! Clone function for the Polyline class.
+SVGElement *Polyline::clone() const { return new Polyline(*this); }
+
+//! Measure function for the Polyline class.
+void Polyline::measure(size_t &elements, size_t &vertices) const {
+    elements++;
+    vertices += points.size();
+}
+
+//! Bounds function for the Polyline class.
+Box Polyline::bounds() const {
+    if (!stroked) {
+        return EMPTY_BOX;
     }
-    if (transform.find("rotate") != string::npos) {
-        r_angle = stoi(
-            transform.substr(transform.find("(") + 1,
-                             transform.find(")") - transform.find("(") - 1));
-        for (Point &p : points) {
-            p = p.rotate(origin, r_angle);
+    return Box::around(points.data(), points.data() + points.size())
+        .grow(stroke_extent(style));
+}
+
+//! Set color function for the Polyline class.
+void Polyline::set_color(const Color &color) { stroke = color; }
+
+//! Set points function for the Polyline class.
+void Polyline::set_points(const vector<Point> &points) {
+    this->points = points;
+}
+
+//! Apply opacity function for the Polyline class.
+void Polyline::apply_opacity(double opacity, double fill_opacity,
+                             double stroke_opacity) {
+    stroke_alpha = fade(stroke_alpha, opacity * stroke_opacity);
+}
+
+//! Set gradients function for the Polyline class.
+void Polyline::set_gradients(const shared_ptr<const Gradient> &fill,
+                             const shared_ptr<const Gradient> &stroke) {
+    stroke_gradient = stroke;
+}
+
+//! Constructor for the Path class.
+Path::Path(const char *data, const Contours &contours, bool filled,
+           const Color &fill, FillRule rule, bool stroked, const Color &stroke,
+           const StrokeStyle &style)
+    : data(data != nullptr && strpbrk(data, "CcSsQqTtAa") != nullptr
+               ? make_shared<const string>(data)
+               : nullptr),
+      contours(contours), filled(filled), fill(fill), rule(rule),
+      stroked(stroked), stroke(stroke), style(style) {}
+
+//! Draw function for the Path class.
+void Path::draw(PNGImage &img) const {
+    const Point *p = contours.points.data();
+    const Point *end = p + contours.points.size();
+    if (filled) {
+        useGradient(img, fill_gradient.get(), p, end);
+        img.set_alpha(fill_alpha);
+        img.draw_polygon(p, contours.ends.data(), contours.size(), rule, fill);
+    }
+    if (stroked) {
+        useGradient(img, stroke_gradient.get(), p, end);
+        img.set_alpha(stroke_alpha);
+        beginStroke();
+        for (size_t i = 0; i < contours.size(); i++) {
+            size_t first = contours.begin(i);
+            strokeContour(img, p + first, contours.ends[i] - first,
+                          contours.closed[i], style, stroke);
         }
+        fillStroke(img, stroke);
     }
-    if (transform.find("scale") != string::npos) {
-        scale_factor = stoi(
-            transform.substr(transform.find("(") + 1,
-                             transform.find(")") - transform.find("(") - 1));
-        for (Point &p : points) {
-            p = p.scale(origin, scale_factor);
+    img.set_alpha(255);
+    img.set_gradient(nullptr);
+}
+
+//! Transform function for the Path class.
+void Path::transform(string transform, Point origin) {
+    transformPoints(transform, origin, contours.points);
+    if (data != nullptr) {
+        // Segments flattened at a smaller scale would show once scaled up,
+        // so the curves are flattened again and all transforms replayed.
+        transforms.push_back({transform, origin});
+        vector<Point> unit = {{0, 0}, {1, 0}};
+        transformPoints(transform, origin, unit);
+        scale *= hypot(unit[1].x - unit[0].x, unit[1].y - unit[0].y);
+        if (scale > flattened_scale * 1.01) {
+            Contours flat;
+            parse_path(data->c_str(), DEFAULT_FLATTENING_TOLERANCE / scale,
+                       flat);
+            for (const auto &t : transforms) {
+                transformPoints(t.first, t.second, flat.points);
+            }
+            contours = move(flat);
+            flattened_scale = scale;
         }
     }
+    transformGradient(fill_gradient, transform, origin);
+    transformGradient(stroke_gradient, transform, origin);
 }
 
-//! Clone function for the Polyline class.
-SVGElement *Polyline::clone() const { return new Polyline(stroke, points); }
+//! Clone function for the Path class.
+SVGElement *Path::clone() const { return new Path(*this); }
+
+//! Measure function for the Path class.
+void Path::measure(size_t &elements, size_t &vertices) const {
+    elements++;
+    vertices += contours.points.size();
+}
+
+//! Bounds function for the Path class.
+Box Path::bounds() const {
+    if (!filled && !stroked) {
+        return EMPTY_BOX;
+    }
+    const Point *p = contours.points.data();
+    Box box = Box::around(p, p + contours.points.size());
+    return stroked ? box.grow(stroke_extent(style)) : box;
+}
+
+//! Set color function for the Path class.
+void Path::set_color(const Color &color) {
+    if (filled || !stroked) {
+        fill = color;
+    } else {
+        stroke = color;
+    }
+}
+
+//! Apply opacity function for the Path class.
+void Path::apply_opacity(double opacity, double fill_opacity,
+                         double stroke_opacity) {
+    fill_alpha = fade(fill_alpha, opacity * fill_opacity);
+    stroke_alpha = fade(stroke_alpha, opacity * stroke_opacity);
+}
+
+//! Set gradients function for the Path class.
+void Path::set_gradients(const shared_ptr<const Gradient> &fill,
+                         const shared_ptr<const Gradient> &stroke) {
+    fill_gradient = fill;
+    stroke_gradient = stroke;
+}
+
+//! Constructor for the Defs class.
+Defs::Defs(const std::vector<SVGElement *> &elements) : elements(elements) {}
 
+//! Destructor for the Defs class.
+Defs::~Defs() {
+    for (SVGElement *element : elements) {
+        delete element;
+    }
+}
+
+//! Draw function for the Defs class.
+void Defs::draw(PNGImage &img) const {}
+
+//! Transform function for the Defs class.
+void Defs::transform(string transform, Point origin) {}
+
+//! Clone function for the Defs class.
+SVGElement *Defs::clone() const {
+    std::vector<SVGElement *> cloned_elements;
+    for (SVGElement *element : elements) {
+        cloned_elements.push_back(element->clone());
+    }
+    return new Defs(cloned_elements);
+}
+
+//! Measure function for the Defs class.
+void Defs::measure(size_t &elements, size_t &vertices) const {
+    elements++;
+    for (SVGElement *element : this->elements) {
+        element->measure(elements, vertices);
+    }
+}
+
+//! Bounds function for the Defs class.
+Box Defs::bounds() const { return EMPTY_BOX; }
+
+//! Set color function for the Defs class.
+void Defs::set_color(const Color &color) {}
+
+//! Constructor for the PaintServer class.
+PaintServer::PaintServer(const shared_ptr<const Gradient> &gradient)
+    : paint(gradient) {}
+
+//! Draw function for the PaintServer class.
+void PaintServer::draw(PNGImage &img) const {}
+
+//! Transform function for the PaintServer class.
+void PaintServer::transform(string transform, Point origin) {}
+
+//! Clone function for the PaintServer class.
+SVGElement *PaintServer::clone() const { return new PaintServer(paint); }
+
+//! Bounds function for the PaintServer class.
+Box PaintServer::bounds() const { return EMPTY_BOX; }
+
+//! Set color function for the PaintServer class.
+void PaintServer::set_color(const Color &color) {}
+
+//! Gradient function for the PaintServer class.
+const shared_ptr<const Gradient> &PaintServer::gradient() const {
+    return paint;
+}
 }   // namespace svg
\ No newline at end of file
@@ -2,9 +2,13 @@
 #define __svg_SVGElements_hpp__
 
 #include "Color.hpp"
+#include "Gradient.hpp"
 #include "PNGImage.hpp"
+#include "PathData.hpp"
 #include "Point.hpp"
+#include "Stroker.hpp"
 #include "external/tinyxml2/tinyxml2.h"
+#include <memory>
 #include <unordered_map>
 using namespace std;
 
@@ -32,6 +36,62 @@ class SVGElement {
     //! Creates a clone of the SVG element.
     //! @return A pointer to the cloned SVG element.
     virtual SVGElement *clone() const = 0;
+
+    //! Gets the pixels the SVG element may draw on.
+    //! @return The bounding box of the element.
+    virtual Box bounds() const = 0;
+
+    //! Changes the color of the SVG element (fill or stroke).
+    //! @param color The new color.
+    virtual void set_color(const Color &color) = 0;
+
+    //! Replaces the points of the SVG element.
+    //! Only polygons and polylines have points; other elements throw.
+    //! @param points The new points.
+    virtual void set_points(const vector<Point> &points);
+
+    //! Multiplies the opacity of the SVG element. A shape applies the
+    //! overall opacity to both its fill and stroke; a group applies it to
+    //! its drawing as a whole. Elements that paint nothing ignore it.
+    //! @param opacity Overall opacity, from 0 to 1.
+    //! @param fill_opacity Fill opacity, from 0 to 1.
+    //! @param stroke_opacity Stroke opacity, from 0 to 1.
+    virtual void apply_opacity(double opacity, double fill_opacity,
+                               double stroke_opacity);
+
+    //! Paints the fill and/or stroke of the SVG element with gradients
+    //! instead of colors. Elements without a fill or stroke ignore it.
+    //! @param fill Gradient for the fill, or nullptr for its color.
+    //! @param stroke Gradient for the stroke, or nullptr for its color.
+    virtual void set_gradients(const shared_ptr<const Gradient> &fill,
+                               const shared_ptr<const Gradient> &stroke);
+
+    //! Counts the SVG element, the elements it contains and their
+    //! vertices, as a copy of it would hold.
+    //! @param elements Incremented by the number of elements.
+    //! @param vertices Incremented by the number of vertices.
+    virtual void measure(size_t &elements, size_t &vertices) const;
+
+    //! Lists the parts of the SVG element that draw independently, in
+    //! drawing order; drawing them one after the other paints the same
+    //! pixels as drawing the element. An element is its own single part.
+    //! @param parts Appended with the parts.
+    virtual void parts(vector<const SVGElement *> &parts) const;
+};
+
+//! Bounds on the size of a document, checked while it is parsed so that
+//! a hostile file fails early instead of exhausting memory or time.
+struct Limits {
+    //! Most pixels of the canvas (width times height).
+    size_t max_pixels = size_t(1) << 28;
+    //! Most elements, counting those nested in groups.
+    size_t max_elements = 1000000;
+    //! Deepest nesting of groups, definitions and symbols.
+    int max_depth = 256;
+    //! Most polygon, polyline and path vertices, over all elements.
+    size_t max_vertices = 10000000;
+    //! Most bytes of a gzip-compressed (.svgz) file once inflated.
+    size_t max_inflated_bytes = size_t(1) << 28;
 };
 
 //! Reads an SVG file and extracts its dimensions and SVG elements.
@@ -41,6 +101,33 @@ class SVGElement {
 void readSVG(const string &svg_file, Point &dimensions,
              vector<SVGElement *> &svg_elements);
 
+//! Reads an SVG file and extracts its dimensions, SVG elements and the
+//! elements that have an id attribute.
+//! @param svg_file The path to the SVG file.
+//! @param dimensions The dimensions of the SVG file.
+//! @param svg_elements The vector to store the SVG elements.
+//! @param dictionary The dictionary to store the SVG elements by ID.
+//! @param limits Bounds on the document; exceeding one throws.
+void readSVG(const string &svg_file, Point &dimensions,
+             vector<SVGElement *> &svg_elements,
+             unordered_map<string, SVGElement *> &dictionary,
+             const Limits &limits = Limits());
+
+//! Parses SVG text already read into memory, plain or gzip-compressed, and
+//! extracts its dimensions, SVG elements and the elements that have an id
+//! attribute.
+//! @param data The file contents.
+//! @param size The size of the file contents, in bytes.
+//! @param name The file name, for error messages.
+//! @param dimensions The dimensions of the SVG file.
+//! @param svg_elements The vector to store the SVG elements.
+//! @param dictionary The dictionary to store the SVG elements by ID.
+//! @param limits Bounds on the document; exceeding one throws.
+void readSVG(const char *data, size_t size, const string &name,
+             Point &dimensions, vector<SVGElement *> &svg_elements,
+             unordered_map<string, SVGElement *> &dictionary,
+             const Limits &limits = Limits());
+
 //! Parses an XML element and creates the corresponding SVG element.
 //! @param child The XML element to parse.
 //! @param shapes The vector to store the parsed SVG elements.
@@ -62,7 +149,9 @@ class Ellipse : public SVGElement {
     //! @param fill The fill color of the ellipse.
     //! @param center The center point of the ellipse.
     //! @param radius The radius of the ellipse.
-    Ellipse(const Color &fill, const Point &center, const Point &radius);
+    //! @param filled Whether the ellipse is filled (fill="none" is not).
+    Ellipse(const Color &fill, const Point &center, const Point &radius,
+            bool filled = true);
 
     //! Draws the ellipse on the given PNG image.
     //! @param img The PNG image to draw on.
@@ -78,10 +167,39 @@ class Ellipse : public SVGElement {
     //! @return A pointer to the cloned ellipse.
     SVGElement *clone() const override;
 
+    //! Gets the bounding box of the ellipse.
+    //! @return The bounding box.
+    Box bounds() const override;
+
+    //! Changes the fill color of the ellipse.
+    //! @param color The new color.
+    void set_color(const Color &color) override;
+
+    //! Multiplies the opacity of the ellipse fill.
+    //! @param opacity Overall opacity, from 0 to 1.
+    //! @param fill_opacity Fill opacity, from 0 to 1.
+    //! @param stroke_opacity Stroke opacity, from 0 to 1.
+    void apply_opacity(double opacity, double fill_opacity,
+                       double stroke_opacity) override;
+
+    //! Paints the ellipse fill with a gradient.
+    //! @param fill Gradient for the fill, or nullptr for its color.
+    //! @param stroke Gradient for the stroke, or nullptr for its color.
+    void set_gradients(const shared_ptr<const Gradient> &fill,
+                       const shared_ptr<const Gradient> &stroke) override;
+
   private:
+    //! Gets the half width and half height of the rotated ellipse.
+    //! @return The extent from the center to the sides of the bounds.
+    Point extent() const;
+
     Color fill;     //! The fill color of the ellipse.Point center;
     Point center;   //! The center point of the ellipse.Point radius;
-    Point radius;   //! The radius of the ellipse.
+    Point radius;   //! The radius of the ellipse, along its own axes.
+    double angle = 0;   //! Clockwise rotation of the axes, in degrees.
+    bool filled;        //! Whether the ellipse is filled.
+    int fill_alpha = 255;   //! The opacity of the fill, from 0 to 255.
+    shared_ptr<const Gradient> fill_gradient;   //! Gradient of the fill.
 };
 
 //! @class Polygon
@@ -91,7 +209,15 @@ class Polygon : public SVGElement {
     //! Constructor for Polygon.
     //! @param fill The fill color of the polygon.
     //! @param points The points that define the polygon.
-    Polygon(const Color &fill, const vector<Point> &points);
+    //! @param rule The fill rule, for polygons that cross themselves.
+    //! @param stroked Whether the outline of the polygon is stroked.
+    //! @param stroke The stroke color of the polygon.
+    //! @param style How the outline is stroked.
+    //! @param filled Whether the polygon is filled (fill="none" is not).
+    Polygon(const Color &fill, const vector<Point> &points,
+            FillRule rule = FillRule::nonzero, bool stroked = false,
+            const Color &stroke = {0, 0, 0},
+            const StrokeStyle &style = DEFAULT_STROKE, bool filled = true);
 
     //! Draws the polygon on the given PNG image.
     //! @param img The PNG image to draw on.
@@ -107,9 +233,48 @@ class Polygon : public SVGElement {
     //! @return A pointer to the cloned polygon.
     SVGElement *clone() const override;
 
+    //! Gets the bounding box of the polygon.
+    //! @return The bounding box.
+    Box bounds() const override;
+
+    //! Counts the polygon and its points.
+    //! @param elements Incremented by the number of elements.
+    //! @param vertices Incremented by the number of vertices.
+    void measure(size_t &elements, size_t &vertices) const override;
+
+    //! Changes the fill color of the polygon.
+    //! @param color The new color.
+    void set_color(const Color &color) override;
+
+    //! Replaces the points of the polygon.
+    //! @param points The new points.
+    void set_points(const vector<Point> &points) override;
+
+    //! Multiplies the opacity of the polygon fill and stroke.
+    //! @param opacity Overall opacity, from 0 to 1.
+    //! @param fill_opacity Fill opacity, from 0 to 1.
+    //! @param stroke_opacity Stroke opacity, from 0 to 1.
+    void apply_opacity(double opacity, double fill_opacity,
+                       double stroke_opacity) override;
+
+    //! Paints the polygon fill and/or stroke with gradients.
+    //! @param fill Gradient for the fill, or nullptr for its color.
+    //! @param stroke Gradient for the stroke, or nullptr for its color.
+    void set_gradients(const shared_ptr<const Gradient> &fill,
+                       const shared_ptr<const Gradient> &stroke) override;
+
   private:
     Color fill;   //! The fill color of the polygon.vector<Point> points;
     vector<Point> points;   //! The points that define the polygon.
+    FillRule rule;          //! The fill rule of the polygon.
+    bool filled;            //! Whether the polygon is filled.
+    bool stroked;           //! Whether the outline is stroked.
+    Color stroke;           //! The stroke color of the polygon.
+    StrokeStyle style;      //! How the outline is stroked.
+    int fill_alpha = 255;   //! The opacity of the fill, from 0 to 255.
+    int stroke_alpha = 255;   //! The opacity of the stroke, from 0 to 255.
+    shared_ptr<const Gradient> fill_gradient;     //! Gradient of the fill.
+    shared_ptr<const Gradient> stroke_gradient;   //! Gradient of the stroke.
 };
 
 //! @class Polyline
@@ -119,7 +284,11 @@ class Polyline : public SVGElement {
     //! Constructor for Polyline.
     //! @param stroke The stroke color of the polyline.
     //! @param points The points that define the polyline.
-    Polyline(const Color &stroke, const vector<Point> &points);
+    //! @param style How the polyline is stroked.
+    //! @param stroked Whether the polyline is stroked (stroke="none" or
+    //! no stroke is not).
+    Polyline(const Color &stroke, const vector<Point> &points,
+             const StrokeStyle &style = DEFAULT_STROKE, bool stroked = true);
 
     //! Draws the polyline on the given PNG image.
     //! @param img The PNG image to draw on.
@@ -135,9 +304,123 @@ class Polyline : public SVGElement {
     //! @return A pointer to the cloned polyline.
     SVGElement *clone() const override;
 
+    //! Gets the bounding box of the polyline.
+    //! @return The bounding box.
+    Box bounds() const override;
+
+    //! Counts the polyline and its points.
+    //! @param elements Incremented by the number of elements.
+    //! @param vertices Incremented by the number of vertices.
+    void measure(size_t &elements, size_t &vertices) const override;
+
+    //! Changes the stroke color of the polyline.
+    //! @param color The new color.
+    void set_color(const Color &color) override;
+
+    //! Replaces the points of the polyline.
+    //! @param points The new points.
+    void set_points(const vector<Point> &points) override;
+
+    //! Multiplies the opacity of the polyline stroke.
+    //! @param opacity Overall opacity, from 0 to 1.
+    //! @param fill_opacity Fill opacity, from 0 to 1.
+    //! @param stroke_opacity Stroke opacity, from 0 to 1.
+    void apply_opacity(double opacity, double fill_opacity,
+                       double stroke_opacity) override;
+
+    //! Paints the polyline stroke with a gradient.
+    //! @param fill Gradient for the fill, or nullptr for its color.
+    //! @param stroke Gradient for the stroke, or nullptr for its color.
+    void set_gradients(const shared_ptr<const Gradient> &fill,
+                       const shared_ptr<const Gradient> &stroke) override;
+
   private:
     Color stroke;           //!  The stroke color of the polyline.
     vector<Point> points;   //! The points that define the polyline.
+    StrokeStyle style;      //! How the polyline is stroked.
+    bool stroked;           //! Whether the polyline is stroked.
+    int stroke_alpha = 255;   //! The opacity of the stroke, from 0 to 255.
+    shared_ptr<const Gradient> stroke_gradient;   //! Gradient of the stroke.
+};
+
+//! @class Path
+//! Represents an SVG path element, flattened into polygonal contours.
+class Path : public SVGElement {
+  public:
+    //! Constructor for Path.
+    //! @param data The path data, kept if it has curves, so that they can
+    //! be flattened again when the path is scaled up.
+    //! @param contours The subpaths of the path data, flattened with
+    //! DEFAULT_FLATTENING_TOLERANCE.
+    //! @param filled Whether the path is filled.
+    //! @param fill The fill color of the path.
+    //! @param rule The fill rule, deciding which areas subpaths enclose.
+    //! @param stroked Whether the path is stroked.
+    //! @param stroke The stroke color of the path.
+    //! @param style How the path is stroked.
+    Path(const char *data, const Contours &contours, bool filled,
+         const Color &fill, FillRule rule, bool stroked, const Color &stroke,
+         const StrokeStyle &style);
+
+    //! Draws the path on the given PNG image: all contours are filled
+    //! together in one pass, then stroked.
+    //! @param img The PNG image to draw on.
+    void draw(PNGImage &img) const override;
+
+    //! Transforms the path using the specified transform string and origin.
+    //! Curves are flattened again if the path is scaled up, so that the
+    //! flattening tolerance holds in pixels.
+    //! @param transform_string The transform string.
+    //! @param transform_origin The origin of the transformation.
+    void transform(string transform_string, Point transform_origin) override;
+
+    //! Creates a clone of the path.
+    //! @return A pointer to the cloned path.
+    SVGElement *clone() const override;
+
+    //! Gets the bounding box of the path.
+    //! @return The bounding box.
+    Box bounds() const override;
+
+    //! Counts the path and its vertices.
+    //! @param elements Incremented by the number of elements.
+    //! @param vertices Incremented by the number of vertices.
+    void measure(size_t &elements, size_t &vertices) const override;
+
+    //! Changes the fill color of the path, or its stroke color if it is
+    //! not filled.
+    //! @param color The new color.
+    void set_color(const Color &color) override;
+
+    //! Multiplies the opacity of the path fill and stroke.
+    //! @param opacity Overall opacity, from 0 to 1.
+    //! @param fill_opacity Fill opacity, from 0 to 1.
+    //! @param stroke_opacity Stroke opacity, from 0 to 1.
+    void apply_opacity(double opacity, double fill_opacity,
+                       double stroke_opacity) override;
+
+    //! Paints the path fill and/or stroke with gradients.
+    //! @param fill Gradient for the fill, or nullptr for its color.
+    //! @param stroke Gradient for the stroke, or nullptr for its color.
+    void set_gradients(const shared_ptr<const Gradient> &fill,
+                       const shared_ptr<const Gradient> &stroke) override;
+
+  private:
+    shared_ptr<const string> data;   //! Path data with curves, or null.
+    vector<pair<string, Point>> transforms;   //! Transforms of the data.
+    double scale = 1;    //! Scale of the transforms.
+    double flattened_scale = 1;   //! Scale the contours were flattened at.
+    Contours contours;   //! The flattened subpaths of the path.
+    bool filled;         //! Whether the path is filled.
+    Color fill;          //! The fill color of the path.
+    FillRule rule;       //! The fill rule of the path.
+    bool stroked;        //! Whether the path is stroked.
+    Color stroke;        //! The stroke color of the path.
+    StrokeStyle style;   //! How the path is stroked.
+    int fill_alpha = 255;     //! The opacity of the fill, from 0 to 255.
+    int stroke_alpha = 255;   //! The opacity of the stroke, from 0 to 255.
+    shared_ptr<const Gradient> fill_gradient;     //! Gradient of the fill.
+    shared_ptr<const Gradient> stroke_gradient;   //! Gradient of the stroke.
 };
 
 //! @class Group
@@ -151,7 +434,9 @@ class Group : public SVGElement {
     //! Destructor for Group.
     ~Group();
 
-    //! Draws the group on the given PNG image.
+    //! Draws the group on the given PNG image. A translucent group is
+    //! drawn into a layer covering its bounds, then blended at once, so
+    //! that its elements do not show through each other.
     //! @param img The PNG image to draw on.
     void draw(PNGImage &img) const override;
 
@@ -169,9 +454,36 @@ class Group : public SVGElement {
     //! @return A pointer to the cloned group.
     SVGElement *clone() const override;
 
+    //! Gets the bounding box of the group.
+    //! @return The bounding box.
+    Box bounds() const override;
+
+    //! Counts the group and its elements.
+    //! @param elements Incremented by the number of elements.
+    //! @param vertices Incremented by the number of vertices.
+    void measure(size_t &elements, size_t &vertices) const override;
+
+    //! Lists the parts of the group's elements, or the group itself when
+    //! translucent, since its elements are then blended together.
+    //! @param parts Appended with the parts.
+    void parts(vector<const SVGElement *> &parts) const override;
+
+    //! Changes the color of every element in the group.
+    //! @param color The new color.
+    void set_color(const Color &color) override;
+
+    //! Multiplies the opacity of the group, and the fill and stroke
+    //! opacity of every element in it.
+    //! @param opacity Overall opacity, from 0 to 1.
+    //! @param fill_opacity Fill opacity, from 0 to 1.
+    //! @param stroke_opacity Stroke opacity, from 0 to 1.
+    void apply_opacity(double opacity, double fill_opacity,
+                       double stroke_opacity) override;
+
   private:
     vector<SVGElement *> elements;
     //! The SVG elements contained in the group.
+    int alpha = 255;   //! The opacity of the group, from 0 to 255.
 };
 
 //! @class Use
@@ -199,9 +511,116 @@ class Use : public SVGElement {
     //! @return A pointer to the cloned use element.
     SVGElement *clone() const override;
 
+    //! Gets the bounding box of the use element.
+    //! @return The bounding box.
+    Box bounds() const override;
+
+    //! Counts the use element and its copy.
+    //! @param elements Incremented by the number of elements.
+    //! @param vertices Incremented by the number of vertices.
+    void measure(size_t &elements, size_t &vertices) const override;
+
+    //! Lists the parts of the used SVG element.
+    //! @param parts Appended with the parts.
+    void parts(vector<const SVGElement *> &parts) const override;
+
+    //! Changes the color of the used SVG element.
+    //! @param color The new color.
+    void set_color(const Color &color) override;
+
+    //! Multiplies the opacity of the used SVG element.
+    //! @param opacity Overall opacity, from 0 to 1.
+    //! @param fill_opacity Fill opacity, from 0 to 1.
+    //! @param stroke_opacity Stroke opacity, from 0 to 1.
+    void apply_opacity(double opacity, double fill_opacity,
+                       double stroke_opacity) override;
+
   private:
     SVGElement *element;
     //! The SVG element to use.
 };
+
+//! @class Defs
+//! Holds elements that are only drawn through use elements, such as the
+//! contents of defs and symbol elements.
+class Defs : public SVGElement {
+  public:
+    //! Constructor for Defs.
+    //! @param elements The SVG elements defined.
+    Defs(const vector<SVGElement *> &elements);
+
+    //! Destructor for Defs.
+    ~Defs();
+
+    //! Draws nothing.
+    //! @param img The PNG image (unused).
+    void draw(PNGImage &img) const override;
+
+    //! Does nothing: transforms of ancestors do not apply to definitions.
+    //! @param transform_string The transform string.
+    //! @param transform_origin The origin of the transformation.
+    void transform(string transform_string, Point transform_origin) override;
+
+    //! Creates a clone of the definitions.
+    //! @return A pointer to the cloned definitions.
+    SVGElement *clone() const override;
+
+    //! Gets the bounding box of the definitions, which is empty.
+    //! @return An empty box.
+    Box bounds() const override;
+
+    //! Counts the definitions.
+    //! @param elements Incremented by the number of elements.
+    //! @param vertices Incremented by the number of vertices.
+    void measure(size_t &elements, size_t &vertices) const override;
+
+    //! Does nothing: definitions are recolored through their id.
+    //! @param color The new color.
+    void set_color(const Color &color) override;
+
+  private:
+    vector<SVGElement *> elements;
+    //! The SVG elements defined.
+};
+
+//! @class PaintServer
+//! Represents an SVG linearGradient or radialGradient element. It draws
+//! nothing itself: shapes paint with it through url(#id) fill or stroke
+//! values.
+class PaintServer : public SVGElement {
+  public:
+    //! Constructor for PaintServer.
+    //! @param gradient The gradient defined.
+    PaintServer(const shared_ptr<const Gradient> &gradient);
+
+    //! Draws nothing.
+    //! @param img The PNG image (unused).
+    void draw(PNGImage &img) const override;
+
+    //! Does nothing: gradients move with the shapes they paint.
+    //! @param transform_string The transform string.
+    //! @param transform_origin The origin of the transformation.
+    void transform(string transform_string, Point transform_origin) override;
+
+    //! Creates a clone of the paint server.
+    //! @return A pointer to the cloned paint server.
+    SVGElement *clone() const override;
+
+    //! Gets the bounding box of the paint server, which is empty.
+    //! @return An empty box.
+    Box bounds() const override;
+
+    //! Does nothing: gradients have no single color.
+    //! @param color The new color.
+    void set_color(const Color &color) override;
+
+    //! Gets the gradient defined.
+    //! @return The gradient.
+    const shared_ptr<const Gradient> &gradient() const;
+
+  private:
+    shared_ptr<const Gradient> paint;
+    //! The gradient defined.
+};
 }   // namespace svg
 #endif
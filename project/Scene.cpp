@@ -0,0 +1,93 @@
+#include "Scene.hpp"
+#include <stdexcept>
+
+namespace svg {
+
+//! Constructor for the Scene class.
+Scene::Scene(const std::string &svg_file) {
+    readSVG(svg_file, dimensions_, elements_, dictionary_);
+    image_.reset(new PNGImage((int) dimensions_.x, (int) dimensions_.y));
+    for (const SVGElement *e : elements_) {
+        e->draw(*image_);
+    }
+}
+
+//! Destructor for the Scene class.
+Scene::~Scene() {
+    for (SVGElement *e : elements_) {
+        delete e;
+    }
+}
+
+SVGElement &Scene::lookup(const std::string &id) {
+    auto it = dictionary_.find(id);
+    if (it == dictionary_.end()) {
+        throw std::runtime_error("No element with id " + id);
+    }
+    return *it->second;
+}
+
+void Scene::mark_dirty(Box box) {
+    if (box.empty()) {
+        return;
+    }
+    // Absorb overlapping boxes until none is left; the union may grow
+    // into boxes that did not overlap the original one.
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < dirty_.size(); i++) {
+            if (dirty_[i].intersects(box)) {
+                box = box.unite(dirty_[i]);
+                dirty_[i] = dirty_.back();
+                dirty_.pop_back();
+                merged = true;
+                break;
+            }
+        }
+    }
+    dirty_.push_back(box);
+}
+
+void Scene::set_color(const std::string &id, const Color &color) {
+    SVGElement &e = lookup(id);
+    e.set_color(color);
+    mark_dirty(e.bounds());
+}
+
+void Scene::set_points(const std::string &id,
+                       const std::vector<Point> &points) {
+    SVGElement &e = lookup(id);
+    mark_dirty(e.bounds());
+    e.set_points(points);
+    mark_dirty(e.bounds());
+}
+
+void Scene::transform(const std::string &id,
+                      const std::string &transform_string,
+                      const Point &transform_origin) {
+    SVGElement &e = lookup(id);
+    mark_dirty(e.bounds());
+    e.transform(transform_string, transform_origin);
+    mark_dirty(e.bounds());
+}
+
+const std::vector<Box> &Scene::dirty() const { return dirty_; }
+
+//! Render function for the Scene class.
+void Scene::render() {
+    for (const Box &box : dirty_) {
+        image_->set_clip(box);
+        image_->fill(image_->clip(), {255, 255, 255});
+        for (const SVGElement *e : elements_) {
+            if (e->bounds().intersects(box)) {
+                e->draw(*image_);
+            }
+        }
+    }
+    image_->set_clip({0, 0, image_->width() - 1, image_->height() - 1});
+    dirty_.clear();
+}
+
+const PNGImage &Scene::image() const { return *image_; }
+}   // namespace svg
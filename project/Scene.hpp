@@ -0,0 +1,80 @@
+//! @file Scene.hpp
+#ifndef __svg_Scene_hpp__
+#define __svg_Scene_hpp__
+
+#include "PNGImage.hpp"
+#include "Point.hpp"
+#include "SVGElements.hpp"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace svg {
+
+//! @class Scene
+//! Retained-mode view of an SVG file: the element tree stays in memory
+//! together with its rendered image. Changing an element through the scene
+//! marks the pixels it covered before and after the change as dirty, and
+//! render() only repaints those pixels, redrawing the elements that
+//! intersect them in document order.
+class Scene {
+  public:
+    //! Parses an SVG file and renders it.
+    //! @param svg_file The path to the SVG file.
+    explicit Scene(const std::string &svg_file);
+
+    //! Destructor, releases all elements.
+    ~Scene();
+
+    Scene(const Scene &) = delete;
+    Scene &operator=(const Scene &) = delete;
+
+    //! Changes the color of an element.
+    //! @param id The element id.
+    //! @param color The new color.
+    void set_color(const std::string &id, const Color &color);
+
+    //! Replaces the points of a polygon or polyline.
+    //! @param id The element id.
+    //! @param points The new points.
+    void set_points(const std::string &id, const std::vector<Point> &points);
+
+    //! Transforms an element.
+    //! @param id The element id.
+    //! @param transform_string The transform string.
+    //! @param transform_origin The origin of the transformation.
+    void transform(const std::string &id, const std::string &transform_string,
+                   const Point &transform_origin);
+
+    //! Gets the regions that will be repainted by the next render().
+    //! @return Disjoint dirty boxes.
+    const std::vector<Box> &dirty() const;
+
+    //! Repaints the dirty regions of the image.
+    void render();
+
+    //! Gets the rendered image, as of the last render().
+    //! @return The image.
+    const PNGImage &image() const;
+
+  private:
+    //! Finds an element by id, throwing if there is none.
+    SVGElement &lookup(const std::string &id);
+    //! Adds a box to the dirty regions, merging it with the boxes it
+    //! overlaps so the regions stay disjoint.
+    void mark_dirty(Box box);
+
+    //! Width and height of the document.
+    Point dimensions_;
+    //! Top-level elements, in document order.
+    std::vector<SVGElement *> elements_;
+    //! Elements by id (including nested ones), owned through elements_.
+    std::unordered_map<std::string, SVGElement *> dictionary_;
+    //! Persistent rendered image.
+    std::unique_ptr<PNGImage> image_;
+    //! Regions to repaint.
+    std::vector<Box> dirty_;
+};
+}   // namespace svg
+#endif
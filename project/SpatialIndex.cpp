@@ -0,0 +1,123 @@
+#include "SpatialIndex.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace svg {
+
+namespace {
+//! Doubled center of a box, exact in integers.
+long center_x(const Box &b) { return (long) b.x_min + b.x_max; }
+long center_y(const Box &b) { return (long) b.y_min + b.y_max; }
+
+//! Sort-Tile-Recursive grouping: sorts entries by x, cuts them into
+//! vertical slices, sorts each slice by y and cuts it into groups of
+//! node_size. Returns the boundaries of the groups in order.
+template <typename T, typename GetBox>
+std::vector<size_t> tile(std::vector<T> &entries, size_t node_size,
+                         GetBox get_box) {
+    size_t n = entries.size();
+    size_t groups = (n + node_size - 1) / node_size;
+    size_t slices = (size_t) std::ceil(std::sqrt((double) groups));
+    size_t slice_size = slices == 0 ? n : ((groups + slices - 1) / slices) *
+                                              node_size;
+    std::sort(entries.begin(), entries.end(), [&](const T &a, const T &b) {
+        return center_x(get_box(a)) < center_x(get_box(b));
+    });
+    std::vector<size_t> bounds;
+    for (size_t s = 0; s < n; s += slice_size) {
+        size_t e = std::min(n, s + slice_size);
+        std::sort(entries.begin() + s, entries.begin() + e,
+                  [&](const T &a, const T &b) {
+                      return center_y(get_box(a)) < center_y(get_box(b));
+                  });
+        for (size_t g = s; g < e; g += node_size) {
+            bounds.push_back(g);
+        }
+    }
+    bounds.push_back(n);
+    return bounds;
+}
+}   // namespace
+
+SpatialIndex::SpatialIndex() {}
+
+SpatialIndex::SpatialIndex(const std::vector<Box> &boxes) {
+    std::vector<std::pair<Box, uint32_t>> entries;
+    entries.reserve(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++) {
+        if (!boxes[i].empty()) {
+            entries.push_back(std::make_pair(boxes[i], (uint32_t) i));
+        }
+    }
+    if (entries.empty()) {
+        return;
+    }
+
+    // Leaves over the boxes themselves.
+    std::vector<size_t> bounds =
+        tile(entries, NODE_SIZE,
+             [](const std::pair<Box, uint32_t> &e) { return e.first; });
+    boxes_.reserve(entries.size());
+    items_.reserve(entries.size());
+    for (const std::pair<Box, uint32_t> &e : entries) {
+        boxes_.push_back(e.first);
+        items_.push_back(e.second);
+    }
+    std::vector<Node> level;
+    for (size_t g = 0; g + 1 < bounds.size(); g++) {
+        Node node = {EMPTY_BOX, (uint32_t) bounds[g],
+                     (uint32_t) (bounds[g + 1] - bounds[g])};
+        for (size_t i = bounds[g]; i < bounds[g + 1]; i++) {
+            node.box = node.box.unite(boxes_[i]);
+        }
+        level.push_back(node);
+    }
+    levels_.push_back(level);
+
+    // Upper levels over the nodes of the level below, until one root.
+    while (levels_.back().size() > 1) {
+        std::vector<Node> &below = levels_.back();
+        bounds = tile(below, NODE_SIZE, [](const Node &n) { return n.box; });
+        std::vector<Node> above;
+        for (size_t g = 0; g + 1 < bounds.size(); g++) {
+            Node node = {EMPTY_BOX, (uint32_t) bounds[g],
+                         (uint32_t) (bounds[g + 1] - bounds[g])};
+            for (size_t i = bounds[g]; i < bounds[g + 1]; i++) {
+                node.box = node.box.unite(below[i].box);
+            }
+            above.push_back(node);
+        }
+        levels_.push_back(above);
+    }
+}
+
+void SpatialIndex::query(const Box &region, std::vector<size_t> &hits) const {
+    size_t first_hit = hits.size();
+    if (levels_.empty() || region.empty()) {
+        return;
+    }
+    // Depth-first traversal with an explicit stack of (level, node).
+    std::vector<std::pair<size_t, uint32_t>> stack;
+    stack.push_back(std::make_pair(levels_.size() - 1, (uint32_t) 0));
+    while (!stack.empty()) {
+        size_t level = stack.back().first;
+        const Node &node = levels_[level][stack.back().second];
+        stack.pop_back();
+        if (!node.box.intersects(region)) {
+            continue;
+        }
+        if (level == 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                if (boxes_[i].intersects(region)) {
+                    hits.push_back(items_[i]);
+                }
+            }
+        } else {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                stack.push_back(std::make_pair(level - 1, i));
+            }
+        }
+    }
+    std::sort(hits.begin() + first_hit, hits.end());
+}
+}   // namespace svg
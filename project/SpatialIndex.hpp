@@ -0,0 +1,52 @@
+//! @file SpatialIndex.hpp
+#ifndef __svg_SpatialIndex_hpp__
+#define __svg_SpatialIndex_hpp__
+
+#include "Point.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace svg {
+
+//! @class SpatialIndex
+//! Static R-tree over a set of boxes, bulk-loaded with the
+//! Sort-Tile-Recursive algorithm. Nodes of each level are stored
+//! contiguously, so the tree is a handful of flat arrays and building it
+//! for millions of boxes costs a few sorts.
+class SpatialIndex {
+  public:
+    //! Builds an index with no boxes.
+    SpatialIndex();
+
+    //! Builds the index.
+    //! @param boxes The boxes to index; empty boxes are never reported.
+    explicit SpatialIndex(const std::vector<Box> &boxes);
+
+    //! Finds the boxes that intersect a region.
+    //! @param region The region to query.
+    //! @param hits Receives the indices of the intersecting boxes, in
+    //! increasing order, appended to any it holds already.
+    void query(const Box &region, std::vector<size_t> &hits) const;
+
+  private:
+    //! Maximum number of children (or boxes) per node.
+    static const size_t NODE_SIZE = 16;
+
+    //! A node covers entries [first, first + count) of the level below,
+    //! or of items_ for leaves.
+    struct Node {
+        Box box;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    //! Indexed boxes, reordered so that each leaf covers a contiguous range.
+    std::vector<Box> boxes_;
+    //! Original index of each entry of boxes_.
+    std::vector<uint32_t> items_;
+    //! levels_[0] holds the leaves, levels_.back() the root.
+    std::vector<std::vector<Node>> levels_;
+};
+}   // namespace svg
+#endif
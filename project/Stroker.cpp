@@ -0,0 +1,212 @@
+//! @file Stroker.cpp
+#include "Stroker.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace svg
+{
+    bool is_stroked(const StrokeStyle &style)
+    {
+        return style.width > 0;
+    }
+
+    bool is_hairline(const StrokeStyle &style)
+    {
+        return is_stroked(style) && style.width <= 1;
+    }
+
+    int stroke_extent(const StrokeStyle &style)
+    {
+        if (!is_stroked(style) || is_hairline(style))
+        {
+            return 0;
+        }
+        double reach = 1;
+        if (style.join == LineJoin::miter)
+        {
+            reach = std::max(reach, style.miter_limit);
+        }
+        if (style.cap == LineCap::square)
+        {
+            reach = std::max(reach, std::sqrt(2.0));
+        }
+        // One more pixel for the outline drawn around filled pieces.
+        return (int)std::ceil(style.width / 2 * reach) + 1;
+    }
+
+    namespace
+    {
+        //! Appends a convex piece, reversed if needed so that every piece
+        //! has a positive signed area.
+        void add_piece(const Point *piece, size_t n, Contours &out)
+        {
+            double area = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                const Point &a = piece[i], &b = piece[(i + 1) % n];
+                area += a.x * b.y - b.x * a.y;
+            }
+            if (area >= 0)
+            {
+                out.points.insert(out.points.end(), piece, piece + n);
+            }
+            else
+            {
+                for (size_t i = n; i > 0; i--)
+                {
+                    out.points.push_back(piece[i - 1]);
+                }
+            }
+            out.ends.push_back(out.points.size());
+            out.closed.push_back(true);
+        }
+
+        //! Appends a circle, as a polygon within the tolerance. Increasing
+        //! angles already give a positive signed area.
+        void add_circle(const Point &c, double r, double tolerance, Contours &out)
+        {
+            double step = 2 * std::acos(std::max(-1.0, 1 - tolerance / r));
+            int n = std::max(8, std::min(1000, (int)std::ceil(2 * M_PI / step)));
+            for (int i = 0; i < n; i++)
+            {
+                double a = 2 * M_PI * i / n;
+                out.points.push_back({c.x + r * std::cos(a), c.y + r * std::sin(a)});
+            }
+            out.ends.push_back(out.points.size());
+            out.closed.push_back(true);
+        }
+
+        Point unit(const Point &a, const Point &b)
+        {
+            double dx = b.x - a.x, dy = b.y - a.y;
+            double len = std::sqrt(dx * dx + dy * dy);
+            return {dx / len, dy / len};
+        }
+
+        //! Appends the join at vertex p, between directions d0 and d1.
+        void add_join(const Point &p, const Point &d0, const Point &d1,
+                      const StrokeStyle &style, double tolerance, Contours &out)
+        {
+            double hw = style.width / 2;
+            double cross = d0.x * d1.y - d0.y * d1.x;
+            double dot = d0.x * d1.x + d0.y * d1.y;
+            // Nearly straight on, the segments already meet within the
+            // tolerance: the gap between them is hw |n1 - n0|.
+            double gap = (d1.x - d0.x) * (d1.x - d0.x) + (d1.y - d0.y) * (d1.y - d0.y);
+            if (dot > 0 && hw * hw * gap <= tolerance * tolerance)
+            {
+                return;
+            }
+            if (style.join == LineJoin::round)
+            {
+                add_circle(p, hw, tolerance, out);
+                return;
+            }
+            // The outer corner is on the side the contour turns away from.
+            double s = cross > 0 ? -hw : hw;
+            Point a = {p.x - d0.y * s, p.y + d0.x * s};
+            Point b = {p.x - d1.y * s, p.y + d1.x * s};
+            if (style.join == LineJoin::miter && dot > -1 + 1e-12)
+            {
+                // Miter length relative to the stroke width is
+                // 1 / cos(half the angle between the segment normals).
+                Point m = {-(d0.y + d1.y), d0.x + d1.x};
+                double len = std::sqrt(m.x * m.x + m.y * m.y);
+                double ratio = 2 / len;
+                if (ratio <= style.miter_limit)
+                {
+                    // The tip is ratio * hw away from p along m.
+                    double k = s * ratio / len;
+                    Point tip = {p.x + m.x * k, p.y + m.y * k};
+                    Point piece[4] = {p, a, tip, b};
+                    add_piece(piece, 4, out);
+                    return;
+                }
+            }
+            Point piece[3] = {p, a, b};
+            add_piece(piece, 3, out);
+        }
+    }
+
+    void stroke_contour(const Point *input, size_t n, bool closed,
+                        const StrokeStyle &style, double tolerance, Contours &out)
+    {
+        double hw = style.width / 2;
+        if (n == 0 || !(hw > 0))
+        {
+            return;
+        }
+        // Repeated vertices have no direction; skip them.
+        static thread_local std::vector<Point> points;
+        points.clear();
+        for (size_t i = 0; i < n; i++)
+        {
+            if (points.empty() || input[i].x != points.back().x || input[i].y != points.back().y)
+            {
+                points.push_back(input[i]);
+            }
+        }
+        if (closed && points.size() > 1 && points.front().x == points.back().x &&
+            points.front().y == points.back().y)
+        {
+            points.pop_back();
+        }
+        size_t m = points.size();
+        if (m == 1)
+        {
+            // A lone point only shows with round or square caps.
+            const Point &p = points[0];
+            if (style.cap == LineCap::round)
+            {
+                add_circle(p, hw, tolerance, out);
+            }
+            else if (style.cap == LineCap::square)
+            {
+                Point piece[4] = {{p.x - hw, p.y - hw}, {p.x + hw, p.y - hw},
+                                  {p.x + hw, p.y + hw}, {p.x - hw, p.y + hw}};
+                add_piece(piece, 4, out);
+            }
+            return;
+        }
+        closed = closed && m > 2;
+
+        size_t segments = closed ? m : m - 1;
+        for (size_t i = 0; i < segments; i++)
+        {
+            Point a = points[i], b = points[(i + 1) % m];
+            Point d = unit(a, b);
+            if (!closed && style.cap == LineCap::square)
+            {
+                if (i == 0)
+                {
+                    a = {a.x - d.x * hw, a.y - d.y * hw};
+                }
+                if (i == segments - 1)
+                {
+                    b = {b.x + d.x * hw, b.y + d.y * hw};
+                }
+            }
+            Point nrm = {-d.y * hw, d.x * hw};
+            Point piece[4] = {{a.x + nrm.x, a.y + nrm.y}, {b.x + nrm.x, b.y + nrm.y},
+                              {b.x - nrm.x, b.y - nrm.y}, {a.x - nrm.x, a.y - nrm.y}};
+            add_piece(piece, 4, out);
+        }
+
+        // Joins at every vertex between two segments.
+        for (size_t i = closed ? 0 : 1; i < (closed ? m : m - 1); i++)
+        {
+            const Point &p = points[i];
+            Point d0 = unit(points[(i + m - 1) % m], p);
+            Point d1 = unit(p, points[(i + 1) % m]);
+            add_join(p, d0, d1, style, tolerance, out);
+        }
+
+        if (!closed && style.cap == LineCap::round)
+        {
+            add_circle(points.front(), hw, tolerance, out);
+            add_circle(points.back(), hw, tolerance, out);
+        }
+    }
+}
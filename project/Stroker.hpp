@@ -0,0 +1,73 @@
+//! @file Stroker.hpp
+#ifndef __svg_Stroker_hpp__
+#define __svg_Stroker_hpp__
+
+#include "PathData.hpp"
+#include "Point.hpp"
+
+#include <cstddef>
+
+namespace svg
+{
+    //! Shape of the corner where two stroked segments meet.
+    enum class LineJoin
+    {
+        miter,
+        round,
+        bevel
+    };
+
+    //! Shape of the ends of open stroked contours.
+    enum class LineCap
+    {
+        butt,
+        round,
+        square
+    };
+
+    //! How a contour is stroked.
+    struct StrokeStyle
+    {
+        //! Stroke width, in pixels.
+        double width;
+        //! Corner shape.
+        LineJoin join;
+        //! End shape.
+        LineCap cap;
+        //! Longest miter, in stroke widths, before a miter join is beveled.
+        double miter_limit;
+    };
+
+    //! SVG defaults: 1 pixel wide, miter joins limited to 4, butt caps.
+    const StrokeStyle DEFAULT_STROKE = {1, LineJoin::miter, LineCap::butt, 4};
+
+    //! Check if a stroke paints anything: SVG draws no stroke of zero
+    //! width, and a negative or unreadable width draws none either.
+    //! @param style Stroke style.
+    //! @return true if the stroke width is a positive number.
+    bool is_stroked(const StrokeStyle &style);
+
+    //! Check if a stroke is drawn as a thin line rather than filled.
+    //! @param style Stroke style.
+    //! @return true if the stroke paints and is at most 1 pixel wide.
+    bool is_hairline(const StrokeStyle &style);
+
+    //! Get how far the outline of a stroke may reach beyond its contour.
+    //! @param style Stroke style.
+    //! @return Distance in whole pixels.
+    int stroke_extent(const StrokeStyle &style);
+
+    //! Convert the stroke of a contour into fill geometry: one convex piece
+    //! per segment, join and cap, all wound the same way so that filling
+    //! them together with the nonzero rule paints their union.
+    //! @param points Vertices of the contour.
+    //! @param n Number of vertices.
+    //! @param closed Whether the last vertex joins the first.
+    //! @param style Stroke style.
+    //! @param tolerance Maximum distance between round joins or caps and
+    //! the segments that approximate them.
+    //! @param out Receives the pieces (appended to any existing ones).
+    void stroke_contour(const Point *points, size_t n, bool closed,
+                        const StrokeStyle &style, double tolerance, Contours &out);
+}
+#endif
@@ -0,0 +1,288 @@
+#include "Style.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <utility>
+
+namespace svg {
+
+namespace {
+
+//! Whether a character is CSS white space
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+//! Whether a character may be part of a name (identifiers here are plain
+//! ASCII, without escapes)
+bool isNameChar(char c) {
+    return std::isalnum((unsigned char)c) || c == '-' || c == '_';
+}
+
+//! A range of characters without its surrounding white space
+std::string trim(const char *begin, const char *end) {
+    while (begin < end && isSpace(*begin)) {
+        begin++;
+    }
+    while (end > begin && isSpace(end[-1])) {
+        end--;
+    }
+    return std::string(begin, end);
+}
+
+//! A style sheet without its comments
+std::string stripComments(const char *css) {
+    std::string text;
+    for (const char *s = css; *s != '\0';) {
+        if (s[0] == '/' && s[1] == '*') {
+            const char *end = std::strstr(s + 2, "*/");
+            if (end == nullptr) {
+                break;
+            }
+            s = end + 2;
+            text += ' ';
+        } else {
+            text += *s++;
+        }
+    }
+    return text;
+}
+
+//! Position past the block or statement of an at-rule starting at i
+size_t skipAtRule(const std::string &text, size_t i) {
+    int depth = 0;
+    for (; i < text.size(); i++) {
+        if (text[i] == ';' && depth == 0) {
+            return i + 1;
+        }
+        if (text[i] == '{') {
+            depth++;
+        } else if (text[i] == '}' && --depth <= 0) {
+            return i + 1;
+        }
+    }
+    return i;
+}
+
+}   // namespace
+
+void parse_declarations(const char *text, std::vector<Declaration> &out) {
+    const char *s = text;
+    while (*s != '\0') {
+        // A declaration ends at a semicolon outside parentheses and quotes.
+        const char *end = s;
+        int depth = 0;
+        char quote = '\0';
+        for (; *end != '\0' && (*end != ';' || depth > 0 || quote != '\0'); end++) {
+            if (quote != '\0') {
+                quote = *end == quote ? '\0' : quote;
+            } else if (*end == '"' || *end == '\'') {
+                quote = *end;
+            } else if (*end == '(') {
+                depth++;
+            } else if (*end == ')' && depth > 0) {
+                depth--;
+            }
+        }
+        const char *colon = std::find(s, end, ':');
+        if (colon != end) {
+            Declaration d{trim(s, colon), trim(colon + 1, end)};
+            for (char &c : d.property) {
+                c = (char)std::tolower((unsigned char)c);
+            }
+            size_t bang = d.value.rfind('!');
+            if (bang != std::string::npos &&
+                trim(d.value.c_str() + bang + 1, d.value.c_str() + d.value.size()) ==
+                    "important") {
+                d.value = trim(d.value.c_str(), d.value.c_str() + bang);
+            }
+            if (!d.property.empty() && !d.value.empty()) {
+                out.push_back(std::move(d));
+            }
+        }
+        s = *end == ';' ? end + 1 : end;
+    }
+}
+
+bool StyleSheet::compile(const std::string &text, size_t rule,
+                         Selector &out) const {
+    out = Selector();
+    out.rule = rule;
+    out.order = selectors_.size();
+    size_t i = 0, n = text.size();
+    auto name = [&]() {
+        size_t start = i;
+        while (i < n && isNameChar(text[i])) {
+            i++;
+        }
+        return text.substr(start, i - start);
+    };
+    if (i < n && text[i] == '*') {
+        i++;
+    } else {
+        out.type = name();
+    }
+    while (i < n) {
+        char kind = text[i++];
+        std::string part = name();
+        if (part.empty() || (kind != '.' && kind != '#')) {
+            return false;   // Combinators, attributes, pseudo-classes
+        }
+        if (kind == '.') {
+            out.classes.push_back(part);
+        } else if (out.id.empty() || out.id == part) {
+            out.id = part;
+        } else {
+            return false;   // Two different ids never match
+        }
+    }
+    if (out.type.empty() && out.id.empty() && out.classes.empty() &&
+        text != "*") {
+        return false;
+    }
+    out.specificity = (out.id.empty() ? 0 : 1 << 16) +
+                      (int)std::min<size_t>(out.classes.size(), 255) * 256 +
+                      (out.type.empty() ? 0 : 1);
+    return true;
+}
+
+void StyleSheet::add(const char *css) {
+    std::string text = stripComments(css);
+    size_t i = 0;
+    while (i < text.size()) {
+        while (i < text.size() && isSpace(text[i])) {
+            i++;
+        }
+        if (i >= text.size()) {
+            break;
+        }
+        if (text[i] == '@') {
+            i = skipAtRule(text, i);
+            continue;
+        }
+        size_t open = text.find('{', i);
+        if (open == std::string::npos) {
+            break;
+        }
+        size_t close = text.find('}', open);
+        if (close == std::string::npos) {
+            close = text.size();
+        }
+        size_t rule = rules_.size();
+        rules_.push_back(std::vector<Declaration>());
+        parse_declarations(text.substr(open + 1, close - open - 1).c_str(),
+                           rules_.back());
+        // Each selector of the list is a rule of its own, sharing the
+        // declarations.
+        const char *prelude = text.c_str() + i;
+        const char *prelude_end = text.c_str() + open;
+        while (prelude <= prelude_end && !rules_.back().empty()) {
+            const char *comma = std::find(prelude, prelude_end, ',');
+            Selector selector;
+            if (compile(trim(prelude, comma), rule, selector)) {
+                size_t index = selectors_.size();
+                if (!selector.id.empty()) {
+                    by_id_[selector.id].push_back(index);
+                } else if (!selector.classes.empty()) {
+                    by_class_[selector.classes[0]].push_back(index);
+                } else if (!selector.type.empty()) {
+                    by_type_[selector.type].push_back(index);
+                } else {
+                    universal_.push_back(index);
+                }
+                selectors_.push_back(std::move(selector));
+            }
+            prelude = comma + 1;
+        }
+        i = close + 1;
+    }
+}
+
+bool StyleSheet::empty() const { return selectors_.empty(); }
+
+void StyleSheet::match(const char *type, const char *id, const char *classes,
+                       std::vector<const Declaration *> &out) const {
+    out.clear();
+    // Scratch space reused from element to element, so that matching does
+    // not allocate
+    static thread_local std::vector<std::pair<const char *, size_t>> names;
+    static thread_local std::vector<size_t> found;
+    static thread_local std::string key;
+    names.clear();
+    found.clear();
+
+    // The classes of the element
+    for (const char *s = classes; s != nullptr && *s != '\0';) {
+        const char *end = s;
+        while (*end != '\0' && !isSpace(*end)) {
+            end++;
+        }
+        if (end != s) {
+            names.push_back({s, (size_t)(end - s)});
+        }
+        s = *end == '\0' ? end : end + 1;
+    }
+    auto hasClass = [](const std::string &name) {
+        for (const auto &n : names) {
+            if (n.second == name.size() &&
+                std::memcmp(n.first, name.data(), n.second) == 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // Candidates from the indexes, kept if the rest of the selector
+    // matches. A selector is in one index only, under one of its classes,
+    // so it is found twice only if the element repeats that class.
+    auto check = [&](const std::vector<size_t> &candidates) {
+        for (size_t c : candidates) {
+            const Selector &s = selectors_[c];
+            bool ok = (s.type.empty() || s.type == type) &&
+                      (s.id.empty() || (id != nullptr && s.id == id));
+            for (size_t k = 0; ok && k < s.classes.size(); k++) {
+                ok = hasClass(s.classes[k]);
+            }
+            if (ok) {
+                found.push_back(c);
+            }
+        }
+    };
+    auto lookup = [&](const std::unordered_map<std::string, std::vector<size_t>> &index,
+                      const char *name, size_t size) {
+        key.assign(name, size);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            check(it->second);
+        }
+    };
+    if (id != nullptr && !by_id_.empty()) {
+        lookup(by_id_, id, std::strlen(id));
+    }
+    if (!by_class_.empty()) {
+        for (const auto &n : names) {
+            lookup(by_class_, n.first, n.second);
+        }
+    }
+    if (!by_type_.empty()) {
+        lookup(by_type_, type, std::strlen(type));
+    }
+    check(universal_);
+
+    if (found.size() > 1) {
+        std::sort(found.begin(), found.end(), [this](size_t a, size_t b) {
+            const Selector &x = selectors_[a], &y = selectors_[b];
+            return x.specificity != y.specificity
+                       ? x.specificity < y.specificity
+                       : x.order < y.order;
+        });
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+    }
+    for (size_t c : found) {
+        for (const Declaration &d : rules_[selectors_[c].rule]) {
+            out.push_back(&d);
+        }
+    }
+}
+
+}   // namespace svg
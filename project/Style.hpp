@@ -0,0 +1,90 @@
+//! @file Style.hpp
+#ifndef __svg_Style_hpp__
+#define __svg_Style_hpp__
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace svg {
+
+//! A CSS declaration, such as fill: red.
+struct Declaration {
+    //! Property name, in lower case.
+    std::string property;
+    //! Value, without surrounding spaces nor !important.
+    std::string value;
+};
+
+//! Parses CSS declarations separated by semicolons, as found in a style
+//! attribute or in a rule of a style sheet. Declarations without a name or
+//! a colon are skipped.
+//! @param text The declarations.
+//! @param out Receives the declarations, appended in order.
+void parse_declarations(const char *text, std::vector<Declaration> &out);
+
+//! @class StyleSheet
+//! The rules of the style elements of a document, compiled once. Each
+//! selector is indexed by its most specific part (id, else first class,
+//! else element name), so that finding the rules of an element takes a few
+//! hash lookups however long the sheet is.
+//! Selectors made of an element name or *, classes and an id (such as
+//! rect.a.b#c) are supported. Selectors with combinators, attributes or
+//! pseudo-classes never match, and at-rules are skipped.
+class StyleSheet {
+  public:
+    //! Compiles the rules of a style sheet and adds them after the others.
+    //! @param css The style sheet.
+    void add(const char *css);
+
+    //! Check if the sheet has no rules.
+    //! @return true if no selector was compiled.
+    bool empty() const;
+
+    //! Finds the declarations that apply to an element, in cascade order:
+    //! by increasing specificity, then in sheet order, so that applying
+    //! them one after the other leaves the winning values.
+    //! @param type The element name.
+    //! @param id The id attribute, or nullptr.
+    //! @param classes The class attribute, or nullptr.
+    //! @param out Receives the declarations (cleared first).
+    void match(const char *type, const char *id, const char *classes,
+               std::vector<const Declaration *> &out) const;
+
+  private:
+    //! A compiled selector.
+    struct Selector {
+        //! Element name, or empty for any.
+        std::string type;
+        //! Id, or empty for any.
+        std::string id;
+        //! Classes the element must all have.
+        std::vector<std::string> classes;
+        //! Ids, classes and name, weighted so that they compare in order.
+        int specificity;
+        //! Position in the sheet.
+        size_t order;
+        //! Index of the declarations of the rule.
+        size_t rule;
+    };
+
+    //! Compiles one selector of a rule; false if it is not supported.
+    bool compile(const std::string &text, size_t rule, Selector &out) const;
+
+    //! Declarations of each rule.
+    std::vector<std::vector<Declaration>> rules_;
+    //! All the selectors, in sheet order.
+    std::vector<Selector> selectors_;
+    //! Selectors with an id, by id.
+    std::unordered_map<std::string, std::vector<size_t>> by_id_;
+    //! Selectors with classes and no id, by first class.
+    std::unordered_map<std::string, std::vector<size_t>> by_class_;
+    //! Selectors with only an element name, by name.
+    std::unordered_map<std::string, std::vector<size_t>> by_type_;
+    //! Selectors that apply to any element.
+    std::vector<size_t> universal_;
+};
+
+}   // namespace svg
+#endif
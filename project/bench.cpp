@@ -0,0 +1,663 @@
+// Project file headers
+#include "Batch.hpp"
+#include "Document.hpp"
+#include "PathData.hpp"
+#include "SVGElements.hpp"
+
+// C++ library headers
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// POSIX headers
+#include <sys/stat.h>
+using namespace std;
+
+namespace svg
+{
+    //! Minimum time spent measuring each benchmark.
+    const double MIN_SECONDS = 0.5;
+
+    //! Keeps results alive so the optimizer cannot drop benchmarked work.
+    volatile unsigned bench_sink = 0;
+
+    class BenchDriver
+    {
+    private:
+        struct Case
+        {
+            string name;
+            function<void()> body;
+        };
+        string root_path;
+        vector<Case> cases;
+
+        void run_case(const Case &c)
+        {
+            typedef chrono::steady_clock clock;
+            c.body(); // warm-up
+            int iterations = 0;
+            double elapsed = 0;
+            clock::time_point start = clock::now();
+            while (iterations < 3 || elapsed < MIN_SECONDS)
+            {
+                c.body();
+                iterations++;
+                elapsed = chrono::duration<double>(clock::now() - start).count();
+            }
+            cout << left << setw(32) << c.name << right << setw(12)
+                 << fixed << setprecision(3) << elapsed * 1000.0 / iterations
+                 << " ms/iter  (" << iterations << " iterations)" << endl;
+        }
+
+    public:
+        BenchDriver(const string &root_path) : root_path(root_path) {}
+
+        string input(const string &id) const
+        {
+            return root_path + "/input/" + id + ".svg";
+        }
+
+        string output(const string &id, const string &extension = ".svg") const
+        {
+            return root_path + "/output/" + id + extension;
+        }
+
+        void add(const string &name, function<void()> body)
+        {
+            cases.push_back({name, body});
+        }
+
+        void run_benchmarks(const string &spec)
+        {
+            int matched = 0;
+            for (const Case &c : cases)
+            {
+                if (c.name.find(spec) == 0)
+                {
+                    run_case(c);
+                    matched++;
+                }
+            }
+            if (matched == 0)
+            {
+                cout << "No benchmarks matched the spec: " << spec << endl;
+            }
+        }
+    };
+
+    //! Deterministic pseudo-random points inside a w x h box.
+    vector<Point> random_points(size_t n, int w, int h, unsigned seed)
+    {
+        vector<Point> points;
+        for (size_t i = 0; i < n; i++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            int x = (int)((seed >> 8) % (unsigned)w);
+            seed = seed * 1103515245u + 12345u;
+            int y = (int)((seed >> 8) % (unsigned)h);
+            Point p;
+            p.x = x;
+            p.y = y;
+            points.push_back(p);
+        }
+        return points;
+    }
+
+    void register_geometry(BenchDriver &driver)
+    {
+        driver.add("geometry/polygon_fill", []()
+        {
+            PNGImage img(1000, 1000);
+            vector<Point> all = random_points(3 * 2000, 1000, 1000, 7);
+            for (size_t i = 0; i < all.size(); i += 3)
+            {
+                img.draw_polygon({all[i], all[i + 1], all[i + 2]}, {10, 20, 30});
+            }
+            bench_sink += img.at(500, 500).red;
+        });
+        driver.add("geometry/transform_chain", []()
+        {
+            vector<Point> points = random_points(100000, 1000, 1000, 11);
+            Point origin = {500, 500};
+            for (Point &p : points)
+            {
+                p = p.translate({3, -2}).rotate(origin, 30).scale(origin, 2);
+            }
+            bench_sink += (unsigned)points[0].x;
+        });
+        static const vector<Point> many = random_points(200000, 1000, 1000, 13);
+        driver.add("geometry/rotate_per_point", []()
+        {
+            vector<Point> points = many;
+            for (Point &p : points)
+            {
+                p = p.rotate({500, 500}, 30);
+            }
+            bench_sink += (unsigned)points[0].x;
+        });
+        driver.add("geometry/rotate_batch", []()
+        {
+            vector<Point> points = many;
+            rotate_points(points, {500, 500}, 30);
+            bench_sink += (unsigned)points[0].x;
+        });
+    }
+
+    //! parse_color as it was before the perfect-hash parser, for comparison.
+    Color legacy_parse_color(const string &str)
+    {
+        static const map<string, Color> NAMES_TO_COLORS = {
+            {"black", {0, 0, 0}},
+            {"white", {255, 255, 255}},
+            {"red", {255, 0, 0}},
+            {"green", {0, 255, 0}},
+            {"blue", {0, 0, 255}},
+            {"yellow", {255, 255, 0}}};
+        Color c;
+        if (str.at(0) == '#')
+        {
+            int v;
+            istringstream ss(str.substr(1));
+            ss >> hex >> v;
+            c.red = (v >> 16);
+            c.green = (v >> 8) & 0xFF;
+            c.blue = v & 0xFF;
+        }
+        else
+        {
+            c = NAMES_TO_COLORS.at(str);
+        }
+        return c;
+    }
+
+    void register_colors(BenchDriver &driver)
+    {
+        // Attribute values as tinyxml2 hands them out.
+        static const char *const VALUES[] = {"#FADFAA", "red", "#1a2b3c", "blue",
+                                             "white", "#CE7660", "yellow", "black"};
+        const int ROUNDS = 100000;
+        driver.add("color/legacy_parse_color", [=]()
+        {
+            unsigned sum = 0;
+            for (int i = 0; i < ROUNDS; i++)
+            {
+                for (const char *v : VALUES)
+                {
+                    sum += legacy_parse_color(v).green;
+                }
+            }
+            bench_sink += sum;
+        });
+        driver.add("color/parse_color", [=]()
+        {
+            unsigned sum = 0;
+            for (int i = 0; i < ROUNDS; i++)
+            {
+                for (const char *v : VALUES)
+                {
+                    sum += parse_color(v).green;
+                }
+            }
+            bench_sink += sum;
+        });
+    }
+
+    void register_canvas(BenchDriver &driver)
+    {
+        // 1000 x 1000 pixels of spans, opaque and translucent, per format.
+        struct Format
+        {
+            const char *name;
+            PixelFormat format;
+        };
+        for (Format f : {Format{"rgb", PixelFormat::rgb}, Format{"rgbx", PixelFormat::rgbx},
+                          Format{"rgba", PixelFormat::rgba}})
+        {
+            for (int alpha : {255, 128})
+            {
+                string name = string("canvas/span_fill_") + f.name +
+                              (alpha == 255 ? "_opaque" : "_blend");
+                PixelFormat format = f.format;
+                driver.add(name, [format, alpha]()
+                {
+                    static PNGImage img(1000, 1000, format);
+                    img.set_alpha(alpha);
+                    img.draw_polygon({{0, 0}, {999, 0}, {999, 1000}, {0, 1000}}, {10, 20, 30});
+                    bench_sink += img.at(500, 500).red;
+                });
+            }
+        }
+
+        // 1000 x 1000 RGBA layer, half of it transparent, blended at half
+        // opacity over each format.
+        for (Format f : {Format{"rgb", PixelFormat::rgb}, Format{"rgbx", PixelFormat::rgbx},
+                          Format{"rgba", PixelFormat::rgba}})
+        {
+            PixelFormat format = f.format;
+            driver.add(string("canvas/composite_") + f.name, [format]()
+            {
+                static PNGImage img(1000, 1000, format);
+                static PNGImage layer(1000, 1000, PixelFormat::rgba);
+                static bool drawn = false;
+                if (!drawn)
+                {
+                    layer.draw_polygon({{0, 0}, {999, 0}, {0, 999}}, {200, 100, 50});
+                    drawn = true;
+                }
+                img.composite(layer, 128);
+                bench_sink += img.at(10, 10).red;
+            });
+        }
+
+        // 1000 x 1000 pixels of gradient spans, through the lookup table.
+        struct Kind
+        {
+            const char *name;
+            GradientKind kind;
+            vector<Point> points;
+        };
+        vector<GradientStop> stops = {{0, {255, 215, 0}, 1}, {0.5, {255, 69, 0}, 1},
+                                      {1, {128, 0, 128}, 1}};
+        for (const Kind &k : {Kind{"linear", GradientKind::linear, {{0, 0}, {1, 1}}},
+                              Kind{"radial", GradientKind::radial, {{0.5, 0.5}, {0.3, 0.3}, {1, 0.5}}}})
+        {
+            Gradient gradient(k.kind, GradientUnits::bounding_box, SpreadMethod::pad, k.points, stops);
+            driver.add(string("canvas/gradient_fill_") + k.name, [gradient]()
+            {
+                static PNGImage img(1000, 1000);
+                img.set_gradient(&gradient, {0, 0}, {999, 999});
+                img.draw_polygon({{0, 0}, {999, 0}, {999, 1000}, {0, 1000}}, {10, 20, 30});
+                img.set_gradient(nullptr);
+                bench_sink += img.at(500, 500).red;
+            });
+        }
+
+        // 1000 translucent groups of two overlapping circles, each drawn
+        // through its own layer.
+        driver.add("canvas/group_opacity", []()
+        {
+            static PNGImage img(1000, 1000);
+            static vector<SVGElement *> groups;
+            if (groups.empty())
+            {
+                for (const Point &p : random_points(1000, 960, 960, 31))
+                {
+                    Group *group = new Group({new Ellipse({255, 0, 0}, {p.x + 15, p.y + 20}, {15, 15}),
+                                              new Ellipse({0, 0, 255}, {p.x + 25, p.y + 20}, {15, 15})});
+                    group->apply_opacity(0.5, 1, 1);
+                    groups.push_back(group);
+                }
+            }
+            for (const SVGElement *group : groups)
+            {
+                group->draw(img);
+            }
+            bench_sink += img.at(500, 500).red;
+        });
+    }
+
+    void register_ellipses(BenchDriver &driver)
+    {
+        // Circles on a 16 x 16 canvas, so that finding the rows dominates
+        // rather than writing pixels.
+        for (int r : {1, 10, 100, 1000, 10000})
+        {
+            driver.add("ellipse/draw_r" + to_string(r), [r]()
+            {
+                static PNGImage img(16, 16);
+                img.draw_ellipse({8, 8}, {(double)r, (double)r}, {10, 20, 30});
+                bench_sink += img.at(8, 8).red;
+            });
+        }
+        // Flat ellipses, where most rows skip many columns.
+        driver.add("ellipse/draw_flat_10000x100", []()
+        {
+            static PNGImage img(16, 16);
+            img.draw_ellipse({8, 8}, {10000, 100}, {10, 20, 30});
+            bench_sink += img.at(8, 8).red;
+        });
+        // A rotated ellipse filling most of a 500 x 500 canvas, solved per
+        // row against the same ellipse as a 200-point polygon.
+        driver.add("ellipse/rotated_conic", []()
+        {
+            static PNGImage img(500, 500);
+            img.draw_ellipse({250, 250}, {240, 90}, 30, {10, 20, 30});
+            bench_sink += img.at(250, 250).red;
+        });
+        driver.add("ellipse/rotated_polygon200", []()
+        {
+            static vector<Point> outline;
+            if (outline.empty())
+            {
+                double s = sin(M_PI / 6), c = cos(M_PI / 6);
+                for (int i = 0; i < 200; i++)
+                {
+                    double t = 2 * M_PI * i / 200;
+                    double u = 240 * cos(t), v = 90 * sin(t);
+                    outline.push_back({250 + c * u - s * v, 250 + s * u + c * v});
+                }
+            }
+            static PNGImage img(500, 500);
+            img.draw_polygon(outline, {10, 20, 30});
+            bench_sink += img.at(250, 250).red;
+        });
+    }
+
+    void register_paths(BenchDriver &driver)
+    {
+        // 1000 subpaths of cubic, quadratic and arc segments.
+        string d;
+        {
+            ostringstream out;
+            vector<Point> points = random_points(6000, 1000, 1000, 23);
+            for (size_t i = 0; i < points.size(); i += 6)
+            {
+                out << 'M' << points[i].x << ',' << points[i].y
+                    << 'C' << points[i + 1].x << ',' << points[i + 1].y << ' '
+                    << points[i + 2].x << ',' << points[i + 2].y << ' '
+                    << points[i + 3].x << ',' << points[i + 3].y
+                    << "q30,40 60,0t60,0"
+                    << 'A' << 50 << ',' << 30 << " 0 1 1 "
+                    << points[i + 4].x << ',' << points[i + 4].y << 'Z';
+            }
+            d = out.str();
+        }
+        driver.add("path/flatten", [d]()
+        {
+            // Reusing the contours leaves only parsing and flattening.
+            static Contours contours;
+            contours.clear();
+            parse_path(d.c_str(), DEFAULT_FLATTENING_TOLERANCE, contours);
+            bench_sink += contours.points.size();
+        });
+
+        // One shape of 2000 overlapping triangles, filled in a single pass.
+        driver.add("path/compound_fill", []()
+        {
+            static vector<Point> points = random_points(3 * 2000, 1000, 1000, 7);
+            static vector<size_t> ends;
+            for (size_t i = ends.size(); i < 2000; i++)
+            {
+                ends.push_back(3 * (i + 1));
+            }
+            PNGImage img(1000, 1000);
+            img.draw_polygon(points.data(), ends.data(), ends.size(), FillRule::nonzero,
+                             {10, 20, 30});
+            bench_sink += img.at(500, 500).red;
+        });
+
+        // A spiral of 2000 short segments stroked 8 pixels wide, against
+        // the same stroke faked with 8 parallel hairlines.
+        vector<Point> zigzag;
+        for (int i = 0; i < 2000; i++)
+        {
+            double a = i * 0.05, r = 20 + i * 0.2;
+            zigzag.push_back({500 + r * cos(a), 500 + r * sin(a)});
+        }
+        driver.add("path/thick_stroke", [zigzag]()
+        {
+            StrokeStyle style = DEFAULT_STROKE;
+            style.width = 8;
+            Polyline line({10, 20, 30}, zigzag, style);
+            PNGImage img(1000, 1000);
+            line.draw(img);
+            bench_sink += img.at(500, 500).red;
+        });
+        driver.add("path/thick_stroke_parallel_lines", [zigzag]()
+        {
+            PNGImage img(1000, 1000);
+            for (int k = -4; k < 4; k++)
+            {
+                vector<Point> shifted = zigzag;
+                translate_points(shifted, {(double)k, (double)k});
+                Polyline({10, 20, 30}, shifted).draw(img);
+            }
+            bench_sink += img.at(500, 500).red;
+        });
+
+        string lion_path = driver.input("lion_path");
+        driver.add("path/lion_path_parse", [lion_path]()
+        {
+            Document doc(lion_path);
+            bench_sink += doc.size();
+        });
+        driver.add("path/lion_path_draw", [lion_path]()
+        {
+            static Document doc(lion_path);
+            PNGImage img(doc.width(), doc.height());
+            doc.draw(img);
+            bench_sink += img.at(0, 0).red;
+        });
+    }
+
+    void register_documents(BenchDriver &driver)
+    {
+        string lion = driver.input("lion");
+        driver.add("document/lion_parse", [lion]()
+        {
+            Document doc(lion);
+            bench_sink += doc.size();
+        });
+        // The same document, plain and gzip-compressed.
+        string gradient = driver.input("gradient_1");
+        string gradient_svgz = driver.input("svgz_1") + "z";
+        driver.add("document/gradient_parse", [gradient]()
+        {
+            Document doc(gradient);
+            bench_sink += doc.size();
+        });
+        driver.add("document/gradient_parse_svgz", [gradient_svgz]()
+        {
+            Document doc(gradient_svgz);
+            bench_sink += doc.size();
+        });
+        driver.add("document/lion_draw", [lion]()
+        {
+            static Document doc(lion);
+            PNGImage img(doc.width(), doc.height());
+            doc.draw(img);
+            bench_sink += img.at(0, 0).red;
+        });
+        driver.add("document/lion_draw_rgbx", [lion]()
+        {
+            static Document doc(lion);
+            PNGImage img(doc.width(), doc.height(), PixelFormat::rgbx);
+            doc.draw(img);
+            bench_sink += img.at(0, 0).red;
+        });
+
+        // A 20000 x 20000 map of 200k small shapes, rendered as 256 x 256 tiles.
+        // It is never drawn whole, so it may be larger than the default
+        // limit on the canvas.
+        Limits map_limits;
+        map_limits.max_pixels = 20000 * 20000;
+        string many = driver.output("bench_many_shapes");
+        {
+            ofstream out(many);
+            out << "<svg width=\"20000\" height=\"20000\">\n";
+            vector<Point> corners = random_points(200000, 19990, 19990, 17);
+            for (const Point &p : corners)
+            {
+                out << "<rect x=\"" << p.x << "\" y=\"" << p.y
+                    << "\" width=\"10\" height=\"10\" fill=\"red\"/>\n";
+            }
+            out << "</svg>\n";
+        }
+        driver.add("document/many_shapes_parse", [many, map_limits]()
+        {
+            Document doc(many, map_limits);
+            bench_sink += doc.size();
+        });
+        driver.add("document/many_shapes_tile", [many, map_limits]()
+        {
+            static Document doc(many, map_limits);
+            static int tile = 0;
+            PNGImage img(256, 256);
+            doc.render_region((tile % 78) * 256, (tile / 78 % 78) * 256, img);
+            tile += 7;
+            bench_sink += img.at(0, 0).red;
+        });
+        driver.add("document/many_shapes_tile_full_scan", [many, map_limits]()
+        {
+            static Document doc(many, map_limits);
+            static int tile = 0;
+            PNGImage img(256, 256);
+            img.set_origin((tile % 78) * 256, (tile / 78 % 78) * 256);
+            doc.draw(img);
+            tile += 7;
+            bench_sink += img.at(0, 0).red;
+        });
+
+        // The same shapes painted through a style sheet of 2000 rules, by
+        // class and by id, and one style attribute in ten.
+        string styled = driver.output("bench_many_shapes_styled");
+        {
+            ofstream out(styled);
+            out << "<svg width=\"20000\" height=\"20000\">\n<style>\n";
+            for (int i = 0; i < 1000; i++)
+            {
+                out << ".c" << i << " { fill: #" << hex << setw(6) << setfill('0') << i * 16411
+                    << dec << " }\n#r" << i * 100 << " { stroke: black }\n";
+            }
+            out << "</style>\n";
+            vector<Point> corners = random_points(200000, 19990, 19990, 17);
+            for (size_t i = 0; i < corners.size(); i++)
+            {
+                out << "<rect id=\"r" << i << "\" class=\"c" << i % 1000 << "\" x=\""
+                    << corners[i].x << "\" y=\"" << corners[i].y << "\" width=\"10\" height=\"10\"";
+                if (i % 10 == 0)
+                {
+                    out << " style=\"fill-opacity:0.5;stroke-width:2\"";
+                }
+                out << "/>\n";
+            }
+            out << "</svg>\n";
+        }
+        driver.add("document/many_shapes_styled_parse", [styled, map_limits]()
+        {
+            Document doc(styled, map_limits);
+            bench_sink += doc.size();
+        });
+    }
+
+    void register_batch(BenchDriver &driver)
+    {
+        // Eight copies of the lion, one file after the other and through
+        // the batch pipeline, saved as PNG.
+        vector<BatchJob> jobs;
+        for (int i = 0; i < 8; i++)
+        {
+            jobs.push_back({driver.input("lion"), driver.output("bench_batch_" + to_string(i), ".png")});
+        }
+        driver.add("batch/lion_x8_sequential", [jobs]()
+        {
+            for (const BatchJob &job : jobs)
+            {
+                convert(job.input, job.output);
+            }
+            bench_sink += jobs.size();
+        });
+        driver.add("batch/lion_x8_pipeline", [jobs]()
+        {
+            BatchReport report = convert_batch(jobs);
+            bench_sink += report.converted;
+        });
+        // The same copies in a directory rebuilt when none changed, which
+        // only hashes them.
+        string rebuild_in = driver.output("bench_rebuild_in", "");
+        string rebuild_out = driver.output("bench_rebuild_out", "");
+        string lion = driver.input("lion");
+        driver.add("batch/lion_x8_rebuild_unchanged", [lion, rebuild_in, rebuild_out]()
+        {
+            static bool ready = false;
+            if (!ready)
+            {
+                ::mkdir(rebuild_in.c_str(), 0777);
+                for (int i = 0; i < 8; i++)
+                {
+                    ifstream in(lion, ios::binary);
+                    ofstream out(rebuild_in + "/lion_" + to_string(i) + ".svg", ios::binary);
+                    out << in.rdbuf();
+                }
+                rebuild_directory(rebuild_in, rebuild_out, "png");
+                ready = true;
+            }
+            RebuildReport report = rebuild_directory(rebuild_in, rebuild_out, "png");
+            bench_sink += report.unchanged;
+        });
+    }
+
+    void register_output(BenchDriver &driver)
+    {
+        // A 1600 x 1200 canvas shrunk by a factor of 2, and to a size that
+        // does not divide it.
+        driver.add("output/downscale_box2", []()
+        {
+            static PNGImage img(1600, 1200);
+            static PNGImage out(800, 600);
+            img.downscale(out);
+            bench_sink += out.at(0, 0).red;
+        });
+        driver.add("output/downscale_box2_rgbx", []()
+        {
+            static PNGImage img(1600, 1200, PixelFormat::rgbx);
+            static PNGImage out(800, 600, PixelFormat::rgbx);
+            img.downscale(out);
+            bench_sink += out.at(0, 0).red;
+        });
+        driver.add("output/downscale_area_343x257", []()
+        {
+            static PNGImage img(1600, 1200);
+            static PNGImage out(343, 257);
+            img.downscale(out);
+            bench_sink += out.at(0, 0).red;
+        });
+
+        // The rendered lion (800 x 600, 1.44 MB of RGB) saved in each file
+        // format.
+        string lion = driver.input("lion");
+        const pair<string, ImageFormat> formats[] = {
+            {"png", ImageFormat::png}, {"ppm", ImageFormat::ppm},
+            {"qoi", ImageFormat::qoi}, {"raw", ImageFormat::raw}};
+        for (const auto &f : formats)
+        {
+            string file = driver.output("bench_save", "." + f.first);
+            ImageFormat format = f.second;
+            driver.add("output/lion_save_" + f.first, [lion, file, format]()
+            {
+                static Document doc(lion);
+                static PNGImage img(doc.width(), doc.height());
+                static bool drawn = (doc.draw(img), true);
+                img.save(file, format);
+                bench_sink += drawn + img.at(0, 0).red;
+            });
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    --argc;
+    ++argv;
+    svg::BenchDriver driver(argc == 2 ? argv[1] : ".");
+    string spec = argc >= 1 ? argv[0] : "";
+    svg::register_geometry(driver);
+    svg::register_colors(driver);
+    svg::register_canvas(driver);
+    svg::register_ellipses(driver);
+    svg::register_paths(driver);
+    svg::register_documents(driver);
+    svg::register_output(driver);
+    svg::register_batch(driver);
+    driver.run_benchmarks(spec);
+    return 0;
+}
@@ -1,7 +1,13 @@
 
 #include "SVGElements.hpp"
+#include "Style.hpp"
+#include "external/stb/stb_image.h"
 #include "external/tinyxml2/tinyxml2.h"
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 
 using namespace tinyxml2;
@@ -16,360 +22,1030 @@ enum type_code {
     polyline,
     line,
     use,
+    path,
+    text,
+    defs,
+    symbol,
+    nested_svg,
+    title,
+    desc,
+    metadata,
+    linear_gradient,
+    radial_gradient,
+    style,
     other
 };
 
-//! Function to encode the SVG element type string into a type code
-type_code encode(string const &type_string) {
-    if (type_string == "ellipse")
-        return ellipse;
-    else if (type_string == "circle")
-        return circle;
-    else if (type_string == "rect")
-        return rect;
-    else if (type_string == "polygon")
-        return polygon;
-    else if (type_string == "polyline")
-        return polyline;
-    else if (type_string == "line")
-        return line;
-    else if (type_string == "g")
-        return group;
-    else if (type_string == "use")
-        return use;
-    else
+//! Element names, indexed by type code
+const char *const TYPE_NAMES[] = {
+    "g",    "ellipse", "circle", "polygon", "rect",  "polyline",
+    "line", "use",     "path",   "text",    "defs",  "symbol",
+    "svg",  "title",   "desc",   "metadata", "linearGradient",
+    "radialGradient", "style"};
+static_assert(sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]) == other,
+              "TYPE_NAMES must have one name per type code");
+
+//! Compile-time FNV-1a hash of a name, so that names can be used as case
+//! labels. Duplicate labels make hash collisions a compile error.
+constexpr uint32_t name_hash(const char *s, uint32_t h = 2166136261u) {
+    return *s == '\0' ? h : name_hash(s + 1, (h ^ (uint8_t) *s) * 16777619u);
+}
+
+//! Run-time version of name_hash.
+uint32_t runtime_name_hash(const char *s) {
+    uint32_t h = 2166136261u;
+    for (; *s != '\0'; s++) {
+        h = (h ^ (uint8_t) *s) * 16777619u;
+    }
+    return h;
+}
+
+//! Function to encode the SVG element name into a type code, without
+//! allocating: the name's hash selects a candidate that is then confirmed
+type_code encode(const char *name) {
+    type_code code;
+    switch (runtime_name_hash(name)) {
+    case name_hash("g"):
+        code = group;
+        break;
+    case name_hash("ellipse"):
+        code = ellipse;
+        break;
+    case name_hash("circle"):
+        code = circle;
+        break;
+    case name_hash("polygon"):
+        code = polygon;
+        break;
+    case name_hash("rect"):
+        code = rect;
+        break;
+    case name_hash("polyline"):
+        code = polyline;
+        break;
+    case name_hash("line"):
+        code = line;
+        break;
+    case name_hash("use"):
+        code = use;
+        break;
+    case name_hash("path"):
+        code = path;
+        break;
+    case name_hash("text"):
+        code = text;
+        break;
+    case name_hash("defs"):
+        code = defs;
+        break;
+    case name_hash("symbol"):
+        code = symbol;
+        break;
+    case name_hash("svg"):
+        code = nested_svg;
+        break;
+    case name_hash("title"):
+        code = title;
+        break;
+    case name_hash("desc"):
+        code = desc;
+        break;
+    case name_hash("metadata"):
+        code = metadata;
+        break;
+    case name_hash("linearGradient"):
+        code = linear_gradient;
+        break;
+    case name_hash("radialGradient"):
+        code = radial_gradient;
+        break;
+    case name_hash("style"):
+        code = style;
+        break;
+    default:
         return other;
+    }
+    return strcmp(name, TYPE_NAMES[code]) == 0 ? code : other;
 }
 
-//! Function to read an SVG file and extract its elements
-void readSVG(const string &svg_file, Point &dimensions,
-             vector<SVGElement *> &svg_elements) {
-    XMLDocument doc;
-    XMLError r = doc.LoadFile(svg_file.c_str());
+//! Inflates gzip-compressed data (e.g. a .svgz file) into at most max_size
+//! bytes. The decompressed size in the gzip trailer sizes the first try
+static void inflateGzip(const unsigned char *data, size_t size,
+                        const string &name, vector<char> &text,
+                        size_t max_size) {
+    // Header: magic, method (8 is deflate), flags, time, extra flags and
+    // OS, followed by optional fields the flags announce.
+    if (size < 18 || size > INT32_MAX || data[2] != 8) {
+        throw runtime_error("Unable to load " + name);
+    }
+    const unsigned char flags = data[3];
+    size_t start = 10;
+    if (flags & 4) {   // Extra field, with its length
+        start += 2 + (data[start] | data[start + 1] << 8);
+    }
+    for (int bit : {8, 16}) {   // Zero-terminated name and comment
+        if (flags & bit) {
+            while (start < size && data[start] != 0) {
+                start++;
+            }
+            start++;
+        }
+    }
+    if (flags & 2) {   // Header checksum
+        start += 2;
+    }
+    if (start + 8 > size) {
+        throw runtime_error("Unable to load " + name);
+    }
+    // The trailer ends with the decompressed size, modulo 2^32. It comes
+    // from the file, so it only sizes the first try: deflate expands data
+    // at most 1032 times, which bounds the size whatever the trailer says,
+    // and so does the limit.
+    const unsigned char *trailer = data + size - 4;
+    uint32_t expected = trailer[0] | trailer[1] << 8 | trailer[2] << 16 |
+                        (uint32_t)trailer[3] << 24;
+    // The inflater wants a few bytes past the end of the compressed data,
+    // which the trailer provides.
+    const char *deflated = (const char *)data + start;
+    int deflated_size = (int)(size - start);
+    size_t bound = std::min(std::min((size_t)deflated_size * 1032, max_size),
+                            (size_t)INT32_MAX);
+    size_t capacity = expected <= bound ? expected : std::min<size_t>(bound, 1 << 20);
+    for (;;) {
+        vector<char>().swap(text);   // Each try starts over
+        text.resize(capacity);
+        int n = stbi_zlib_decode_noheader_buffer(text.data(), (int)capacity,
+                                                 deflated, deflated_size);
+        if (n >= 0) {
+            text.resize(n);
+            return;
+        }
+        // Corrupt, or larger than the buffer: try again with twice the room.
+        if (capacity >= bound) {
+            throw runtime_error("Unable to load " + name + " (corrupt, or over " +
+                                to_string(bound) + " bytes inflated)");
+        }
+        capacity = std::min(bound, std::max<size_t>(2 * capacity, 1 << 16));
+    }
+}
+
+//! Checks for the gzip magic number at the start of some data
+static bool isGzip(const unsigned char *data, size_t size) {
+    return size >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+}
+
+//! Reads a gzip-compressed file into memory, inflated. Returns false,
+//! reading nothing more, if the file does not start with the gzip magic
+//! number
+static bool readGzip(const string &file, vector<char> &text,
+                     size_t max_size) {
+    ifstream in(file, ios::binary);
+    unsigned char magic[2] = {0, 0};
+    if (!in.read((char *)magic, 2) || !isGzip(magic, 2)) {
+        return false;
+    }
+    in.seekg(0, ios::end);
+    streamoff size = in.tellg();
+    if (size < 0 || size > INT32_MAX) {
+        throw runtime_error("Unable to load " + file);
+    }
+    vector<unsigned char> data((size_t)size);
+    in.seekg(0);
+    if (!in.read((char *)data.data(), size)) {
+        throw runtime_error("Unable to load " + file);
+    }
+    inflateGzip(data.data(), data.size(), file, text, max_size);
+    return true;
+}
+
+//! What is left of the limits of the document being parsed by this thread;
+//! null outside readElements, where nothing is limited
+struct Budget {
+    const Limits &limits;
+    const string &name;
+    size_t elements;
+    size_t vertices;
+    int depth;
+};
+static thread_local Budget *budget = nullptr;
+
+//! Throws if a limit of the document being parsed is exceeded
+static void checkLimit(bool exceeded, const char *what, size_t limit) {
+    if (exceeded) {
+        throw runtime_error(budget->name + ": more than " + to_string(limit) +
+                            " " + what);
+    }
+}
+
+//! Counts vertices against the limit of the document being parsed
+static void countVertices(size_t n) {
+    if (budget != nullptr) {
+        budget->vertices += n;
+        checkLimit(budget->vertices > budget->limits.max_vertices, "vertices",
+                   budget->limits.max_vertices);
+    }
+}
+
+//! Counts the elements and vertices copied by a use element against the
+//! limits, before they are copied: nested uses multiply the size of a
+//! document, so they are what an unbounded file would be made of
+static void countCopy(const SVGElement *element) {
+    if (budget != nullptr) {
+        size_t elements = 0, vertices = 0;
+        element->measure(elements, vertices);
+        budget->elements += elements;
+        checkLimit(budget->elements > budget->limits.max_elements, "elements",
+                   budget->limits.max_elements);
+        countVertices(vertices);
+    }
+}
+
+//! Makes the limits of a document apply to the parsing functions until
+//! destroyed
+struct BudgetScope {
+    Budget b;
+    BudgetScope(const Limits &limits, const string &name)
+        : b{limits, name, 0, 0, 0} {
+        budget = &b;
+    }
+    ~BudgetScope() { budget = nullptr; }
+};
+
+//! Rules of the style elements of the document being parsed by this
+//! thread; null outside readElements or when there are none
+static thread_local const StyleSheet *style_sheet = nullptr;
+
+//! Compiles the style elements found anywhere below the root, since their
+//! rules apply to elements before them as well as after
+static void readStyleSheet(const XMLElement *root, StyleSheet &sheet) {
+    const XMLElement *e = root->FirstChildElement();
+    while (e != NULL) {
+        if (strcmp(e->Name(), "style") == 0) {
+            string css;   // Text and CDATA sections
+            for (const XMLNode *n = e->FirstChild(); n != NULL;
+                 n = n->NextSibling()) {
+                if (n->ToText() != NULL) {
+                    css += n->Value();
+                }
+            }
+            sheet.add(css.c_str());
+        } else if (e->FirstChildElement() != NULL) {
+            e = e->FirstChildElement();
+            continue;
+        }
+        // Next element in document order, without recursion
+        while (e != NULL && e->NextSiblingElement() == NULL) {
+            e = e->Parent() == root ? NULL : e->Parent()->ToElement();
+        }
+        if (e != NULL) {
+            e = e->NextSiblingElement();
+        }
+    }
+}
+
+//! Makes the style sheet of a document apply to the parsing functions
+//! until destroyed
+struct StyleSheetScope {
+    explicit StyleSheetScope(const StyleSheet &sheet) {
+        style_sheet = sheet.empty() ? nullptr : &sheet;
+    }
+    ~StyleSheetScope() { style_sheet = nullptr; }
+};
+
+//! Gradient elements of the document being parsed by this thread, by id,
+//! found on the first paint that refers to a gradient not parsed yet, since
+//! paints may refer to gradients defined after them; null outside
+//! readElements
+struct LaterGradients {
+    const XMLElement *root;
+    bool scanned;
+    unordered_map<string, const XMLElement *> elements;
+    //! Gradients parsed ahead of their turn, null while being parsed
+    unordered_map<string, shared_ptr<const Gradient>> parsed;
+};
+static thread_local LaterGradients *later_gradients = nullptr;
+
+//! Lists the gradient elements found anywhere below the root
+static void scanGradients(LaterGradients &g) {
+    const XMLElement *e = g.root->FirstChildElement();
+    while (e != NULL) {
+        const char *id = e->Attribute("id");
+        if (id != NULL && (strcmp(e->Name(), "linearGradient") == 0 ||
+                           strcmp(e->Name(), "radialGradient") == 0)) {
+            g.elements.emplace(id, e);
+        } else if (e->FirstChildElement() != NULL) {
+            e = e->FirstChildElement();
+            continue;
+        }
+        // Next element in document order, without recursion
+        while (e != NULL && e->NextSiblingElement() == NULL) {
+            e = e->Parent() == g.root ? NULL : e->Parent()->ToElement();
+        }
+        if (e != NULL) {
+            e = e->NextSiblingElement();
+        }
+    }
+    g.scanned = true;
+}
+
+//! Makes the gradients of a document available to paints before them
+//! until destroyed
+struct LaterGradientsScope {
+    LaterGradients g;
+    explicit LaterGradientsScope(const XMLElement *root)
+        : g{root, false, {}, {}} {
+        later_gradients = &g;
+    }
+    ~LaterGradientsScope() { later_gradients = nullptr; }
+};
+
+//! Extracts the dimensions and elements of a loaded XML document
+static void readElements(XMLDocument &doc, XMLError r, const string &name,
+                         Point &dimensions, vector<SVGElement *> &svg_elements,
+                         unordered_map<string, SVGElement *> &dictionary,
+                         const Limits &limits) {
     if (r != XML_SUCCESS) {
-        throw runtime_error("Unable to load " + svg_file);
+        throw runtime_error("Unable to load " + name);
     }
     XMLElement *xml_elem = doc.RootElement();
     vector<SVGElement *> shapes;
 
     dimensions.x = xml_elem->IntAttribute("width");
     dimensions.y = xml_elem->IntAttribute("height");
-    unordered_map<string, SVGElement *> dictionary;
+    BudgetScope scope(limits, name);
+    if (!(dimensions.x > 0 && dimensions.y > 0)) {
+        throw runtime_error(name + ": missing, zero or negative width or height");
+    }
+    checkLimit((double)dimensions.x * dimensions.y > (double)limits.max_pixels,
+               "pixels", limits.max_pixels);
+    StyleSheet sheet;
+    readStyleSheet(xml_elem, sheet);
+    StyleSheetScope sheet_scope(sheet);
+    LaterGradientsScope gradients_scope(xml_elem);
 
     //! Iterate through each child element of the root element
-    for (XMLElement *child = xml_elem->FirstChildElement(); child != NULL;
-         child = child->NextSiblingElement()) {
-        parseElement(child, shapes, dictionary);
+    try {
+        for (XMLElement *child = xml_elem->FirstChildElement(); child != NULL;
+             child = child->NextSiblingElement()) {
+            parseElement(child, shapes, dictionary);
+        }
+        // Curves flattened again when scaled up have more vertices than
+        // were counted as they were read.
+        size_t elements = 0, vertices = 0;
+        for (const SVGElement *e : shapes) {
+            e->measure(elements, vertices);
+        }
+        checkLimit(vertices > limits.max_vertices, "vertices",
+                   limits.max_vertices);
+    } catch (...) {
+        //! Do not leak the elements parsed so far
+        for (SVGElement *e : shapes) {
+            delete e;
+        }
+        dictionary.clear();
+        throw;
     }
 
-    svg_elements = shapes;
-    shapes.clear();
+    svg_elements.swap(shapes);
 }
 
-//! Function to parse an SVG element and create the corresponding shape object
-void parseElement(tinyxml2::XMLElement *child,
-                  vector<svg::SVGElement *> &shapes,
-                  unordered_map<string, SVGElement *> &dictionary) {
-    string child_name(child->Name());
-    Color c_fill;
-    Point c_center;
-    Point c_radius;
-    vector<Point> c_points;
-    Color c_stroke;
-    string point_str;
-    string point;
-    string delimiter = " ";
-    size_t pos = 0;
+//! Function to read an SVG file and extract its elements
+void readSVG(const string &svg_file, Point &dimensions,
+             vector<SVGElement *> &svg_elements) {
+    unordered_map<string, SVGElement *> dictionary;
+    readSVG(svg_file, dimensions, svg_elements, dictionary);
+}
+
+//! Function to read an SVG file and extract its elements and id dictionary
+void readSVG(const string &svg_file, Point &dimensions,
+             vector<SVGElement *> &svg_elements,
+             unordered_map<string, SVGElement *> &dictionary,
+             const Limits &limits) {
+    XMLDocument doc;
+    XMLError r;
+    vector<char> text;
+    if (readGzip(svg_file, text, limits.max_inflated_bytes)) {
+        r = doc.Parse(text.data(), text.size());
+    } else {
+        r = doc.LoadFile(svg_file.c_str());
+    }
+    readElements(doc, r, svg_file, dimensions, svg_elements, dictionary,
+                 limits);
+}
+
+//! Function to parse SVG text already in memory and extract its elements
+//! and id dictionary
+void readSVG(const char *data, size_t size, const string &name,
+             Point &dimensions, vector<SVGElement *> &svg_elements,
+             unordered_map<string, SVGElement *> &dictionary,
+             const Limits &limits) {
+    XMLDocument doc;
+    XMLError r;
+    const unsigned char *bytes = (const unsigned char *)data;
+    if (isGzip(bytes, size)) {
+        vector<char> text;
+        inflateGzip(bytes, size, name, text, limits.max_inflated_bytes);
+        r = doc.Parse(text.data(), text.size());
+    } else {
+        r = doc.Parse(data, size);
+    }
+    readElements(doc, r, name, dimensions, svg_elements, dictionary, limits);
+}
+
+//! Attribute values used by parseElement, filled in one pass over the
+//! attribute list of an element. Strings point into the XML document.
+struct Attributes {
+    const char *id = nullptr;
+    const char *fill = nullptr;
+    const char *stroke = nullptr;
+    const char *points = nullptr;
+    const char *href = nullptr;
+    const char *transform = nullptr;
+    const char *d = nullptr;
+    const char *class_names = nullptr;
+    const char *style = nullptr;
+    const char *stop_color = nullptr;
+    double stop_opacity = 1;
+    //! Declarations of the style attribute: a.fill and a.stroke may point
+    //! into their values, so the vector must not grow after they are read
+    vector<Declaration> declarations;
+    FillRule fill_rule = FillRule::nonzero;
+    StrokeStyle stroke_style = DEFAULT_STROKE;
+    double opacity = 1, fill_opacity = 1, stroke_opacity = 1;
     Point origin = {0, 0};
+    double x = 0, y = 0, width = 0, height = 0;
+    double cx = 0, cy = 0, r = 0, rx = 0, ry = 0;
+    double x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+};
 
-    string transform = "";
-    string transform_origin = "";
-
-    switch (encode(child_name)) {   // Switch based on the encoded child name
-    case group: {                   // If the element is a group
-        vector<SVGElement *> group_shapes;
-        // Iterate through each child element of the group element
-        for (XMLElement *group_child = child->FirstChildElement();
-             group_child != NULL;
-             group_child = group_child->NextSiblingElement()) {
-            parseElement(group_child, group_shapes,
-                         dictionary);   // Recursively parse each child element
-        }
-        // Check and store the transform attribute if it exists
-        if (child->Attribute("transform") != NULL) {
-            transform = child->Attribute("transform");
-            if (child->Attribute("transform-origin") != NULL) {
-                transform_origin = child->Attribute("transform-origin");
-                origin = {
-                    stoi(
-                        transform_origin.substr(0, transform_origin.find(" "))),
-                    stoi(transform_origin.substr(transform_origin.find(" ") + 1,
-                                                 transform_origin.size()))};
-            }
+//! Function to parse a list of numbers separated by whitespace and/or
+//! commas into points (pairs of numbers)
+vector<Point> parsePoints(const char *str) {
+    vector<Point> points;
+    if (str == NULL) {
+        return points;
+    }
+    double v[2];
+    int n = 0;
+    const char *s = str;
+    while (true) {
+        while (*s == ' ' || *s == ',' || *s == '\t' || *s == '\n' ||
+               *s == '\r') {
+            s++;
         }
-        Group *g = new Group(
-            group_shapes);   // Create a new Group object with the parsed shapes
-        if (transform != "") {
-            g->transform(transform, origin);   // Apply transformation if exists
-        }
-        if (child->Attribute("id") != NULL) {
-            dictionary[child->Attribute("id")] =
-                g;   // Store the group in the dictionary if it has an ID
-        }
-        shapes.push_back(g);   // Add the group to the shapes vector
-        break;
-    }
-    case ellipse: {   // If the element is an ellipse
-        c_fill =
-            parse_color(child->Attribute("fill"));   // Parse the fill color
-        c_center = {child->IntAttribute("cx"),
-                    child->IntAttribute("cy")};   // Get center coordinates
-        c_radius = {child->IntAttribute("rx"),
-                    child->IntAttribute("ry")};   // Get radii
-
-        // Check and store the transform attribute if it exists
-        if (child->Attribute("transform") != NULL) {
-            transform = child->Attribute("transform");
-            if (child->Attribute("transform-origin") != NULL) {
-                transform_origin = child->Attribute("transform-origin");
-                origin = {
-                    stoi(
-                        transform_origin.substr(0, transform_origin.find(" "))),
-                    stoi(transform_origin.substr(transform_origin.find(" ") + 1,
-                                                 transform_origin.size()))};
-            }
+        if (*s == '\0') {
+            break;
+        }
+        char *end;
+        v[n++] = strtod(s, &end);
+        if (end == s) {
+            throw runtime_error(string("Invalid points: ") + str);
+        }
+        s = end;
+        if (n == 2) {
+            points.push_back({v[0], v[1]});
+            n = 0;
+        }
+    }
+    if (n != 0) {
+        throw runtime_error(string("Odd number of coordinates: ") + str);
+    }
+    return points;
+}
+
+//! Function to read a presentation property, given as an attribute or in a
+//! style; false if the name is not one
+bool readPresentation(uint32_t hash, const char *name, const char *value,
+                      Attributes &a) {
+    // Each label is checked against the name, since names that are not
+    // listed may share a hash with one that is
+    switch (hash) {
+        case name_hash("fill"):
+            if (strcmp(name, "fill") == 0)
+                a.fill = value;
+            break;
+        case name_hash("stroke"):
+            if (strcmp(name, "stroke") == 0)
+                a.stroke = value;
+            break;
+        case name_hash("fill-rule"):
+            if (strcmp(name, "fill-rule") == 0)
+                a.fill_rule = strcmp(value, "evenodd") == 0 ? FillRule::evenodd
+                                                            : FillRule::nonzero;
+            break;
+        case name_hash("stroke-width"):
+            if (strcmp(name, "stroke-width") == 0)
+                a.stroke_style.width = strtod(value, NULL);
+            break;
+        case name_hash("stroke-linejoin"):
+            if (strcmp(name, "stroke-linejoin") == 0)
+                a.stroke_style.join = strcmp(value, "round") == 0 ? LineJoin::round
+                                      : strcmp(value, "bevel") == 0
+                                          ? LineJoin::bevel
+                                          : LineJoin::miter;
+            break;
+        case name_hash("stroke-linecap"):
+            if (strcmp(name, "stroke-linecap") == 0)
+                a.stroke_style.cap = strcmp(value, "round") == 0 ? LineCap::round
+                                     : strcmp(value, "square") == 0
+                                         ? LineCap::square
+                                         : LineCap::butt;
+            break;
+        case name_hash("stroke-miterlimit"):
+            if (strcmp(name, "stroke-miterlimit") == 0)
+                a.stroke_style.miter_limit = strtod(value, NULL);
+            break;
+        case name_hash("opacity"):
+            if (strcmp(name, "opacity") == 0)
+                a.opacity = strtod(value, NULL);
+            break;
+        case name_hash("fill-opacity"):
+            if (strcmp(name, "fill-opacity") == 0)
+                a.fill_opacity = strtod(value, NULL);
+            break;
+        case name_hash("stroke-opacity"):
+            if (strcmp(name, "stroke-opacity") == 0)
+                a.stroke_opacity = strtod(value, NULL);
+            break;
+        case name_hash("stop-color"):
+            if (strcmp(name, "stop-color") == 0)
+                a.stop_color = value;
+            break;
+        case name_hash("stop-opacity"):
+            if (strcmp(name, "stop-opacity") == 0)
+                a.stop_opacity = strtod(value, NULL);
+            break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+//! Function to apply a declaration from a style sheet or a style attribute
+void readDeclaration(const Declaration &d, Attributes &a) {
+    const char *name = d.property.c_str();
+    readPresentation(runtime_name_hash(name), name, d.value.c_str(), a);
+}
+
+//! Function to read all the attributes of an element in a single pass,
+//! then the rules of the style sheet that match it and its style attribute,
+//! which override the attributes in that order
+void readAttributes(const XMLElement *child, Attributes &a) {
+    for (const XMLAttribute *attr = child->FirstAttribute(); attr != NULL;
+         attr = attr->Next()) {
+        const char *name = attr->Name();
+        const char *value = attr->Value();
+        uint32_t hash = runtime_name_hash(name);
+        if (readPresentation(hash, name, value, a)) {
+            continue;
         }
-        Ellipse *e = new Ellipse(c_fill, c_center,
-                                 c_radius);   // Create a new Ellipse object
-        if (transform != "") {
-            e->transform(transform, origin);   // Apply transformation if exists
-        }
-        shapes.push_back(e);   // Add the ellipse to the shapes vector
-        if (child->Attribute("id") != NULL) {
-            dictionary[child->Attribute("id")] =
-                e;   // Store the ellipse in the dictionary if it has an ID
-        }
-        break;
-    }
-    case circle: {   // If the element is a circle
-        c_fill =
-            parse_color(child->Attribute("fill"));   // Parse the fill color
-        c_center = {child->IntAttribute("cx"),
-                    child->IntAttribute("cy")};   // Get center coordinates
-        c_radius = {child->IntAttribute("r"),
-                    child->IntAttribute("r")};   // Get radius
-
-        // Check and store the transform attribute if it exists
-        if (child->Attribute("transform") != NULL) {
-            transform = child->Attribute("transform");
-            if (child->Attribute("transform-origin") != NULL) {
-                transform_origin = child->Attribute("transform-origin");
-                origin = {
-                    stoi(
-                        transform_origin.substr(0, transform_origin.find(" "))),
-                    stoi(transform_origin.substr(transform_origin.find(" ") + 1,
-                                                 transform_origin.size()))};
+        // Each label is checked against the name, since names that are not
+        // listed may share a hash with one that is
+        switch (hash) {
+        case name_hash("id"):
+            if (strcmp(name, "id") == 0)
+                a.id = value;
+            break;
+        case name_hash("d"):
+            if (strcmp(name, "d") == 0)
+                a.d = value;
+            break;
+        case name_hash("points"):
+            if (strcmp(name, "points") == 0)
+                a.points = value;
+            break;
+        case name_hash("href"):
+            if (strcmp(name, "href") == 0)
+                a.href = value;
+            break;
+        case name_hash("xlink:href"):
+            if (strcmp(name, "xlink:href") == 0)
+                a.href = value;
+            break;
+        case name_hash("transform"):
+            if (strcmp(name, "transform") == 0)
+                a.transform = value;
+            break;
+        case name_hash("transform-origin"):
+            if (strcmp(name, "transform-origin") == 0) {
+                vector<Point> origin = parsePoints(value);
+                if (origin.size() != 1) {
+                    throw runtime_error(string("Invalid transform-origin: ") +
+                                        value);
+                }
+                a.origin = origin[0];
             }
+            break;
+        case name_hash("x"):
+            if (strcmp(name, "x") == 0)
+                a.x = attr->DoubleValue();
+            break;
+        case name_hash("y"):
+            if (strcmp(name, "y") == 0)
+                a.y = attr->DoubleValue();
+            break;
+        case name_hash("width"):
+            if (strcmp(name, "width") == 0)
+                a.width = attr->DoubleValue();
+            break;
+        case name_hash("height"):
+            if (strcmp(name, "height") == 0)
+                a.height = attr->DoubleValue();
+            break;
+        case name_hash("cx"):
+            if (strcmp(name, "cx") == 0)
+                a.cx = attr->DoubleValue();
+            break;
+        case name_hash("cy"):
+            if (strcmp(name, "cy") == 0)
+                a.cy = attr->DoubleValue();
+            break;
+        case name_hash("r"):
+            if (strcmp(name, "r") == 0)
+                a.r = attr->DoubleValue();
+            break;
+        case name_hash("rx"):
+            if (strcmp(name, "rx") == 0)
+                a.rx = attr->DoubleValue();
+            break;
+        case name_hash("ry"):
+            if (strcmp(name, "ry") == 0)
+                a.ry = attr->DoubleValue();
+            break;
+        case name_hash("x1"):
+            if (strcmp(name, "x1") == 0)
+                a.x1 = attr->DoubleValue();
+            break;
+        case name_hash("y1"):
+            if (strcmp(name, "y1") == 0)
+                a.y1 = attr->DoubleValue();
+            break;
+        case name_hash("x2"):
+            if (strcmp(name, "x2") == 0)
+                a.x2 = attr->DoubleValue();
+            break;
+        case name_hash("y2"):
+            if (strcmp(name, "y2") == 0)
+                a.y2 = attr->DoubleValue();
+            break;
+        case name_hash("class"):
+            if (strcmp(name, "class") == 0)
+                a.class_names = value;
+            break;
+        case name_hash("style"):
+            if (strcmp(name, "style") == 0)
+                a.style = value;
+            break;
+        default:
+            break;   // Attributes that are not supported are ignored
         }
-        Ellipse *c = new Ellipse(c_fill, c_center,
-                                 c_radius);   // Create a new Ellipse object
-                                              // (circles are special ellipses)
-        if (transform != "") {
-            c->transform(transform, origin);   // Apply transformation if exists
+    }
+    if (style_sheet != nullptr) {
+        static thread_local vector<const Declaration *> matched;
+        style_sheet->match(child->Name(), a.id, a.class_names, matched);
+        for (const Declaration *d : matched) {
+            readDeclaration(*d, a);
         }
-        shapes.push_back(c);   // Add the circle to the shapes vector
-        if (child->Attribute("id") != NULL) {
-            dictionary[child->Attribute("id")] =
-                c;   // Store the circle in the dictionary if it has an ID
+    }
+    if (a.style != nullptr) {
+        parse_declarations(a.style, a.declarations);
+        for (const Declaration &d : a.declarations) {
+            readDeclaration(d, a);
         }
-        break;
     }
-    case polygon: {   // If the element is a polygon
-        c_fill =
-            parse_color(child->Attribute("fill"));   // Parse the fill color
-        point_str = child->Attribute("points");      // Get the points attribute
-        while ((pos = point_str.find(delimiter)) !=
-               string::npos) {   // Parse each point
-            point = point_str.substr(0, pos);
-            Point p = {stoi(point.substr(0, point.find(","))),
-                       stoi(point.substr(point.find(",") + 1, point.size()))};
-            c_points.push_back(p);
-            point_str.erase(0, pos + delimiter.length());
-        }
-        c_points.push_back({stoi(point_str.substr(0, point_str.find(","))),
-                            stoi(point_str.substr(point_str.find(",") + 1,
-                                                  point_str.size()))});
-
-        // Check and store the transform attribute if it exists
-        if (child->Attribute("transform") != NULL) {
-            transform = child->Attribute("transform");
-            if (child->Attribute("transform-origin") != NULL) {
-                transform_origin = child->Attribute("transform-origin");
-                origin = {
-                    stoi(
-                        transform_origin.substr(0, transform_origin.find(" "))),
-                    stoi(transform_origin.substr(transform_origin.find(" ") + 1,
-                                                 transform_origin.size()))};
-            }
+}
+
+//! Function to read a gradient coordinate, a number or a percentage
+double gradientCoordinate(const XMLElement *element, const char *name,
+                          double default_value) {
+    const char *value = element->Attribute(name);
+    if (value == NULL) {
+        return default_value;
+    }
+    char *end;
+    double v = strtod(value, &end);
+    if (end == value) {
+        throw runtime_error(string("Invalid ") + name + ": " + value);
+    }
+    return *end == '%' ? v / 100 : v;
+}
+
+static shared_ptr<const Gradient>
+findGradient(const string &id,
+             const unordered_map<string, SVGElement *> &dictionary);
+
+//! Function to parse a linearGradient or radialGradient element, and its
+//! stop children. A gradient without stops uses those of the gradient its
+//! href refers to.
+PaintServer *parseGradient(const XMLElement *element, GradientKind kind,
+                           const Attributes &a,
+                           const unordered_map<string, SVGElement *> &dictionary) {
+    vector<GradientStop> stops;
+    for (const XMLElement *stop = element->FirstChildElement("stop");
+         stop != NULL; stop = stop->NextSiblingElement("stop")) {
+        double offset = gradientCoordinate(stop, "offset", 0);
+        //! Offsets are clamped, and never go backwards
+        offset = std::max(0.0, std::min(1.0, offset));
+        if (!stops.empty()) {
+            offset = std::max(offset, stops.back().offset);
         }
-        Polygon *p =
-            new Polygon(c_fill, c_points);   // Create a new Polygon object
-        if (transform != "") {
-            p->transform(transform, origin);   // Apply transformation if exists
-        }
-        shapes.push_back(p);   // Add the polygon to the shapes vector
-        if (child->Attribute("id") != NULL) {
-            dictionary[child->Attribute("id")] =
-                p;   // Store the polygon in the dictionary if it has an ID
-        }
-        break;
-    }
-    case rect: {   // If the element is a rectangle
-        c_fill =
-            parse_color(child->Attribute("fill"));   // Parse the fill color
-        // Get the rectangle's four corners
-        c_points.push_back(
-            {child->IntAttribute("x"), child->IntAttribute("y")});
-        c_points.push_back(
-            {child->IntAttribute("x") + child->IntAttribute("width") - 1,
-             child->IntAttribute("y")});
-        c_points.push_back(
-            {child->IntAttribute("x") + child->IntAttribute("width") - 1,
-             child->IntAttribute("y") + child->IntAttribute("height") - 1});
-        c_points.push_back(
-            {child->IntAttribute("x"),
-             child->IntAttribute("y") + child->IntAttribute("height") - 1});
-
-        // Check and store the transform attribute if it exists
-        if (child->Attribute("transform") != NULL) {
-            transform = child->Attribute("transform");
-            if (child->Attribute("transform-origin") != NULL) {
-                transform_origin = child->Attribute("transform-origin");
-                origin = {
-                    stoi(
-                        transform_origin.substr(0, transform_origin.find(" "))),
-                    stoi(transform_origin.substr(transform_origin.find(" ") + 1,
-                                                 transform_origin.size()))};
-            }
+        Attributes stop_attributes;
+        readAttributes(stop, stop_attributes);
+        const char *color = stop_attributes.stop_color;
+        stops.push_back({offset, color == NULL ? Color{0, 0, 0} : parse_color(color),
+                         stop_attributes.stop_opacity});
+    }
+    if (stops.empty() && a.href != NULL && a.href[0] == '#') {
+        shared_ptr<const Gradient> ref = findGradient(a.href + 1, dictionary);
+        if (ref != nullptr) {
+            stops = ref->stops();
         }
-        Polygon *r = new Polygon(
-            c_fill,
-            c_points);   // Create a new Polygon object for the rectangle
-        if (transform != "") {
-            r->transform(transform, origin);   // Apply transformation if exists
+    }
+
+    const char *units = element->Attribute("gradientUnits");
+    GradientUnits gradient_units = units != NULL && strcmp(units, "userSpaceOnUse") == 0
+                                       ? GradientUnits::user_space
+                                       : GradientUnits::bounding_box;
+    const char *spread = element->Attribute("spreadMethod");
+    SpreadMethod spread_method = spread == NULL ? SpreadMethod::pad
+                                 : strcmp(spread, "reflect") == 0 ? SpreadMethod::reflect
+                                 : strcmp(spread, "repeat") == 0 ? SpreadMethod::repeat
+                                                                 : SpreadMethod::pad;
+    vector<Point> points;
+    if (kind == GradientKind::linear) {
+        points = {{gradientCoordinate(element, "x1", 0),
+                   gradientCoordinate(element, "y1", 0)},
+                  {gradientCoordinate(element, "x2", 1),
+                   gradientCoordinate(element, "y2", 0)}};
+    } else {
+        Point center = {gradientCoordinate(element, "cx", 0.5),
+                        gradientCoordinate(element, "cy", 0.5)};
+        double r = gradientCoordinate(element, "r", 0.5);
+        points = {center,
+                  {gradientCoordinate(element, "fx", center.x),
+                   gradientCoordinate(element, "fy", center.y)},
+                  {center.x + r, center.y}};
+    }
+    return new PaintServer(make_shared<Gradient>(kind, gradient_units,
+                                                 spread_method, points, stops));
+}
+
+//! Function to find the gradient with the given id: defined earlier, in the
+//! dictionary, or later in the document, parsed ahead of its turn. Returns
+//! null if there is none.
+static shared_ptr<const Gradient>
+findGradient(const string &id,
+             const unordered_map<string, SVGElement *> &dictionary) {
+    auto ref = dictionary.find(id);
+    const PaintServer *server =
+        ref == dictionary.end() ? nullptr
+                                : dynamic_cast<const PaintServer *>(ref->second);
+    if (server != nullptr) {
+        return server->gradient();
+    }
+    if (later_gradients == nullptr) {
+        return nullptr;
+    }
+    LaterGradients &g = *later_gradients;
+    if (!g.scanned) {
+        scanGradients(g);
+    }
+    auto parsed = g.parsed.find(id);
+    if (parsed != g.parsed.end()) {
+        return parsed->second;
+    }
+    auto element = g.elements.find(id);
+    if (element == g.elements.end()) {
+        return nullptr;
+    }
+    //! A gradient whose href leads back to itself finds nothing there
+    g.parsed[id] = nullptr;
+    Attributes a;
+    readAttributes(element->second, a);
+    GradientKind kind = strcmp(element->second->Name(), "linearGradient") == 0
+                            ? GradientKind::linear
+                            : GradientKind::radial;
+    unique_ptr<PaintServer> later(parseGradient(element->second, kind, a, dictionary));
+    return g.parsed[id] = later->gradient();
+}
+
+//! Function to parse a fill or stroke attribute: "none" disables
+//! painting, and a missing attribute uses the default. A url(#id)
+//! reference to a gradient that does not exist paints with the color
+//! after it, if any, or not at all.
+bool parsePaint(const char *value, bool paint_by_default, Color &color,
+                const unordered_map<string, SVGElement *> &dictionary,
+                shared_ptr<const Gradient> &gradient) {
+    gradient.reset();
+    if (value == NULL) {
+        color = {0, 0, 0};
+        return paint_by_default;
+    }
+    if (strncmp(value, "url(#", 5) == 0) {
+        const char *end = strchr(value, ')');
+        if (end != NULL) {
+            gradient = findGradient(string(value + 5, end), dictionary);
         }
-        shapes.push_back(r);   // Add the rectangle to the shapes vector
-        if (child->Attribute("id") != NULL) {
-            dictionary[child->Attribute("id")] =
-                r;   // Store the rectangle in the dictionary if it has an ID
+        if (gradient != nullptr) {
+            color = {0, 0, 0};
+            return true;
+        }
+        value = end == NULL ? "" : end + 1;
+        value += strspn(value, " \t\r\n");
+        if (*value == '\0') {
+            return false;
         }
-        break;
     }
-    case polyline: {   // If the element is a polyline
-        c_stroke =
-            parse_color(child->Attribute("stroke"));   // Parse the stroke color
-        point_str = child->Attribute("points");   // Get the points attribute
-        while ((pos = point_str.find(delimiter)) !=
-               string::npos) {   // Parse each point
-            point = point_str.substr(0, pos);
-            c_points.push_back({stoi(point.substr(0, point.find(","))),
-                                stoi(point.substr(point.find(",") + 1))});
-            point_str.erase(0, pos + delimiter.length());
-        }
-        c_points.push_back({stoi(point_str.substr(0, point_str.find(","))),
-                            stoi(point_str.substr(point_str.find(",") + 1))});
-
-        // Check and store the transform attribute if it exists
-        if (child->Attribute("transform") != NULL) {
-            transform = child->Attribute("transform");
-            if (child->Attribute("transform-origin") != NULL) {
-                transform_origin = child->Attribute("transform-origin");
-                origin = {
-                    stoi(
-                        transform_origin.substr(0, transform_origin.find(" "))),
-                    stoi(transform_origin.substr(transform_origin.find(" ") + 1,
-                                                 transform_origin.size()))};
+    if (strcmp(value, "none") == 0) {
+        return false;
+    }
+    color = parse_color(value);
+    return true;
+}
+
+//! Function to apply the transform and opacity of an element, store it in
+//! the dictionary if it has an ID, and add it to the shapes vector
+void addShape(SVGElement *shape, const Attributes &a,
+              vector<svg::SVGElement *> &shapes,
+              unordered_map<string, SVGElement *> &dictionary) {
+    if (a.transform != NULL) {
+        shape->transform(a.transform, a.origin);
+    }
+    if (a.opacity != 1 || a.fill_opacity != 1 || a.stroke_opacity != 1) {
+        shape->apply_opacity(a.opacity, a.fill_opacity, a.stroke_opacity);
+    }
+    shapes.push_back(shape);
+    if (a.id != NULL) {
+        dictionary[a.id] = shape;
+    }
+}
+
+//! Function to parse the child elements of an element
+vector<SVGElement *>
+parseChildren(tinyxml2::XMLElement *parent,
+              unordered_map<string, SVGElement *> &dictionary) {
+    vector<SVGElement *> children;
+    // Nesting is bounded so that a deep file cannot exhaust the stack.
+    struct Depth {
+        Depth() {
+            if (budget != nullptr) {
+                checkLimit(++budget->depth > budget->limits.max_depth,
+                           "levels of nesting", budget->limits.max_depth);
             }
         }
-        Polyline *p =
-            new Polyline(c_stroke, c_points);   // Create a new Polyline object
-        if (transform != "") {
-            p->transform(transform, origin);   // Apply transformation if exists
-        }
-        shapes.push_back(p);   // Add the polyline to the shapes vector
-        if (child->Attribute("id") != NULL) {
-            dictionary[child->Attribute("id")] =
-                p;   // Store the polyline in the dictionary if it has an ID
-        }
-        break;
-    }
-    case line: {   // If the element is a line
-        c_stroke =
-            parse_color(child->Attribute("stroke"));   // Parse the stroke color
-        // Get the line's start and end points
-        c_points.push_back(
-            {child->IntAttribute("x1"), child->IntAttribute("y1")});
-        c_points.push_back(
-            {child->IntAttribute("x2"), child->IntAttribute("y2")});
-
-        // Check and store the transform attribute if it exists
-        if (child->Attribute("transform") != NULL) {
-            transform = child->Attribute("transform");
-            if (child->Attribute("transform-origin") != NULL) {
-                transform_origin = child->Attribute("transform-origin");
-                origin = {
-                    stoi(
-                        transform_origin.substr(0, transform_origin.find(" "))),
-                    stoi(transform_origin.substr(transform_origin.find(" ") + 1,
-                                                 transform_origin.size()))};
+        ~Depth() {
+            if (budget != nullptr) {
+                budget->depth--;
             }
         }
-        Polyline *l = new Polyline(
-            c_stroke, c_points);   // Create a new Polyline object for the line
-        if (transform != "") {
-            l->transform(transform, origin);   // Apply transformation if exists
+    } depth;
+    try {
+        for (XMLElement *child = parent->FirstChildElement(); child != NULL;
+             child = child->NextSiblingElement()) {
+            parseElement(child, children,
+                         dictionary);   // Recursively parse each child
         }
-        shapes.push_back(l);   // Add the line to the shapes vector
-        if (child->Attribute("id") != NULL) {
-            dictionary[child->Attribute("id")] =
-                l;   // Store the line in the dictionary if it has an ID
+    } catch (...) {
+        for (SVGElement *e : children) {
+            delete e;
         }
+        throw;
+    }
+    return children;
+}
+
+//! Function to parse an SVG element and create the corresponding shape object
+void parseElement(tinyxml2::XMLElement *child,
+                  vector<svg::SVGElement *> &shapes,
+                  unordered_map<string, SVGElement *> &dictionary) {
+    if (budget != nullptr) {
+        checkLimit(++budget->elements > budget->limits.max_elements,
+                   "elements", budget->limits.max_elements);
+    }
+    Attributes a;
+    readAttributes(child, a);
+
+    //! Shapes that may paint with gradients are added after the switch
+    SVGElement *shape = nullptr;
+    shared_ptr<const Gradient> fill_gradient, stroke_gradient;
+    type_code code = encode(child->Name());
+    switch (code) {   // Switch based on the encoded child name
+    case group:   // If the element is a group
+    case nested_svg:   // or a nested svg element, drawn as a group
+        addShape(new Group(parseChildren(child, dictionary)), a, shapes,
+                 dictionary);
+        break;
+    case defs:   // Definitions are only drawn through use elements
+        addShape(new Defs(parseChildren(child, dictionary)), a, shapes,
+                 dictionary);
+        break;
+    case symbol: {   // A symbol is a group that is only drawn through use
+        Group *g = new Group(parseChildren(child, dictionary));
+        shapes.push_back(new Defs({g}));
+        if (a.id != NULL) {
+            dictionary[a.id] = g;
+        }
+        break;
+    }
+    case ellipse:   // If the element is an ellipse
+    case circle: {   // or a circle (circles are special ellipses)
+        Point radius = code == circle ? Point{a.r, a.r} : Point{a.rx, a.ry};
+        Color fill;
+        bool filled = parsePaint(a.fill, true, fill, dictionary, fill_gradient);
+        shape = new Ellipse(fill, {a.cx, a.cy}, radius, filled);
+        break;
+    }
+    case polygon: {   // If the element is a polygon
+        Color fill, stroke;
+        bool filled = parsePaint(a.fill, true, fill, dictionary, fill_gradient);
+        bool stroked =
+            parsePaint(a.stroke, false, stroke, dictionary, stroke_gradient);
+        vector<Point> points = parsePoints(a.points);
+        countVertices(points.size());
+        shape = new Polygon(fill, points, a.fill_rule, stroked, stroke,
+                            a.stroke_style, filled);
+        break;
+    }
+    case rect: {   // If the element is a rectangle, get its four corners
+        vector<Point> corners = {
+            {a.x, a.y},
+            {a.x + a.width - 1, a.y},
+            {a.x + a.width - 1, a.y + a.height - 1},
+            {a.x, a.y + a.height - 1}};
+        Color fill, stroke;
+        bool filled = parsePaint(a.fill, true, fill, dictionary, fill_gradient);
+        bool stroked =
+            parsePaint(a.stroke, false, stroke, dictionary, stroke_gradient);
+        shape = new Polygon(fill, corners, a.fill_rule, stroked, stroke,
+                            a.stroke_style, filled);
+        break;
+    }
+    case polyline: {   // If the element is a polyline
+        vector<Point> points = parsePoints(a.points);
+        countVertices(points.size());
+        Color stroke;
+        bool stroked =
+            parsePaint(a.stroke, false, stroke, dictionary, stroke_gradient);
+        shape = new Polyline(stroke, points, a.stroke_style, stroked);
+        break;
+    }
+    case line: {   // If the element is a line, get its start and end points
+        Color stroke;
+        bool stroked =
+            parsePaint(a.stroke, false, stroke, dictionary, stroke_gradient);
+        shape = new Polyline(stroke, {{a.x1, a.y1}, {a.x2, a.y2}},
+                             a.stroke_style, stroked);
         break;
     }
     case use: {   // If the element is a use element (reference to another
                   // element)
-        string href = child->Attribute("href");   // Get the href attribute
-        string ref = href.substr(1);   // Extract the ID being referenced
-        SVGElement *elem =
-            dictionary[ref];   // Find the referenced element in the dictionary
-        // Check and store the transform attribute if it exists
-        if (child->Attribute("transform") != NULL) {
-            transform = child->Attribute("transform");
-            if (child->Attribute("transform-origin") != NULL) {
-                transform_origin = child->Attribute("transform-origin");
-                origin = {
-                    stoi(
-                        transform_origin.substr(0, transform_origin.find(" "))),
-                    stoi(transform_origin.substr(transform_origin.find(" ") + 1,
-                                                 transform_origin.size()))};
-            }
+        if (a.href == NULL || a.href[0] != '#') {
+            throw runtime_error("use element without a local href");
         }
-
-        Use *u = new Use(
-            elem);   // Create a new Use object for the referenced element
-        if (transform != "") {
-            u->transform(transform, origin);   // Apply transformation if exists
-        }
-        if (child->Attribute("id") != NULL) {
-            dictionary[child->Attribute("id")] =
-                u;   // Store the use element in the dictionary if it has an ID
+        // Find the referenced element in the dictionary
+        auto ref = dictionary.find(a.href + 1);
+        if (ref == dictionary.end()) {
+            throw runtime_error(string("use of unknown element ") + a.href);
         }
-        shapes.push_back(u);   // Add the use element to the shapes vector
+        countCopy(ref->second);
+        addShape(new Use(ref->second), a, shapes, dictionary);
+        break;
+    }
+    case title:   // Descriptive elements are not drawn
+    case desc:
+    case metadata:
+    case style:   // Style sheets are read before the elements
+        break;
+    case path: {   // If the element is a path, flatten its curves
+        Contours contours;
+        parse_path(a.d, DEFAULT_FLATTENING_TOLERANCE, contours);
+        countVertices(contours.points.size());
+        Color fill, stroke;
+        bool filled = parsePaint(a.fill, true, fill, dictionary, fill_gradient);
+        bool stroked =
+            parsePaint(a.stroke, false, stroke, dictionary, stroke_gradient);
+        shape = new Path(a.d, contours, filled, fill, a.fill_rule, stroked,
+                         stroke, a.stroke_style);
         break;
     }
+    case linear_gradient:   // Gradients are only drawn through url(#id) paints
+        addShape(parseGradient(child, GradientKind::linear, a, dictionary), a,
+                 shapes, dictionary);
+        break;
+    case radial_gradient:
+        addShape(parseGradient(child, GradientKind::radial, a, dictionary), a,
+                 shapes, dictionary);
+        break;
+    case text:
+        cout << "Unsupported element: " << child->Name() << endl;
+        break;
     default:
         cout << "Unknown element"
              << endl;   // Print an error message if the element is unknown
     }
+    if (shape != nullptr) {
+        shape->set_gradients(fill_gradient, stroke_gradient);
+        addShape(shape, a, shapes, dictionary);
+    }
 }
-}   // namespace svg
\ No newline at end of file
+}   // namespace svg
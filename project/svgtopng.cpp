@@ -1,17 +1,197 @@
+#include "Batch.hpp"
+#include "Document.hpp"
 #include "SVGElements.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <string>
+#include <vector>
+
+//! Prints the errors of a batch conversion and how busy each stage was.
+static int print_report(const svg::BatchReport &report, size_t n)
+{
+    for (const std::string &error : report.errors)
+    {
+        std::cout << error << std::endl;
+    }
+    std::cout << std::fixed << std::setprecision(3)
+              << "Converted " << report.converted << " of " << n << " files in "
+              << report.seconds << " s" << std::endl;
+    for (const svg::StageReport &stage : report.stages)
+    {
+        std::cout << "  " << std::left << std::setw(8) << stage.name << std::right
+                  << stage.threads << " threads, " << stage.items << " files, busy "
+                  << stage.busy << " s, waiting " << stage.waiting << " s";
+        if (stage.busy > 0)
+        {
+            std::cout << ", " << std::setprecision(1) << stage.items / stage.busy
+                      << " files/s per thread" << std::setprecision(3);
+        }
+        std::cout << std::endl;
+    }
+    return report.errors.empty() ? 0 : 1;
+}
+
+//! Converts several files through the batch pipeline.
+static int convert_batch(const std::string &dir, const std::string &extension,
+                         const svg::BatchOptions &options, int n, char **files)
+{
+    std::vector<svg::BatchJob> jobs;
+    for (int i = 0; i < n; i++)
+    {
+        std::string name = files[i];
+        name = name.substr(name.find_last_of('/') + 1);
+        name = name.substr(0, name.find_last_of('.'));
+        jobs.push_back({files[i], dir + "/" + name + "." + extension});
+    }
+    std::cout << "Performing batch conversion ... " << n << " files --> " << dir << std::endl;
+    return print_report(svg::convert_batch(jobs, options), n);
+}
+
+//! Converts the files of a directory that changed since the last rebuild.
+static int rebuild_directory(const std::string &in_dir, const std::string &out_dir,
+                             const std::string &extension, const svg::BatchOptions &options)
+{
+    std::cout << "Performing rebuild ... " << in_dir << " --> " << out_dir << std::endl;
+    svg::RebuildReport report = svg::rebuild_directory(in_dir, out_dir, extension, options);
+    std::cout << report.unchanged << " files unchanged, " << report.removed
+              << " stale images removed" << std::endl;
+    for (const std::string &conflict : report.conflicts)
+    {
+        std::cout << conflict << std::endl;
+    }
+    int status = print_report(report.batch, report.batch.converted + report.batch.errors.size());
+    return report.conflicts.empty() ? status : 1;
+}
 
 int main(int argc, char **argv)
 {
-    if (argc != 3)
+    // --transparent renders on a transparent RGBA canvas instead of white RGB.
+    // --format png|ppm|qoi|raw overrides the format given by the extension.
+    // --size WxH shrinks the rendering to that size before saving it.
+    // --batch out_dir converts every input file given into out_dir.
+    // --rebuild in_dir out_dir converts the files of in_dir that changed.
+    // --timeout seconds gives up drawing a file of a batch after that long.
+    svg::PixelFormat format = svg::PixelFormat::rgb;
+    const char *file_format = nullptr;
+    const char *batch_dir = nullptr;
+    bool rebuild = false;
+    int size_w = 0, size_h = 0;
+    double timeout = 0;
+    bool usage = false;
+    while (argc > 1 && std::strncmp(argv[1], "--", 2) == 0)
     {
-        std::cout << "Usage: svgtopng in_file.svg out_file.png" << std::endl;
+        if (std::strcmp(argv[1], "--transparent") == 0)
+        {
+            format = svg::PixelFormat::rgba;
+        }
+        else if (std::strcmp(argv[1], "--format") == 0 && argc > 2)
+        {
+            file_format = argv[2];
+            argc--;
+            argv++;
+        }
+        else if (std::strcmp(argv[1], "--batch") == 0 && argc > 2)
+        {
+            batch_dir = argv[2];
+            argc--;
+            argv++;
+        }
+        else if (std::strcmp(argv[1], "--rebuild") == 0)
+        {
+            rebuild = true;
+        }
+        else if (std::strcmp(argv[1], "--timeout") == 0 && argc > 2)
+        {
+            usage = usage || std::sscanf(argv[2], "%lf", &timeout) != 1 || !(timeout > 0);
+            argc--;
+            argv++;
+        }
+        else if (std::strcmp(argv[1], "--size") == 0 && argc > 2)
+        {
+            usage = usage || std::sscanf(argv[2], "%dx%d", &size_w, &size_h) != 2 ||
+                    size_w <= 0 || size_h <= 0;
+            argc--;
+            argv++;
+        }
+        else
+        {
+            usage = true;
+        }
+        argc--;
+        argv++;
     }
-    else
+    svg::BatchOptions options;
+    options.format = format;
+    options.timeout = timeout;
+    std::string extension = file_format ? file_format : "png";
+    if (batch_dir != nullptr && !rebuild && !usage && size_w == 0 && argc > 1)
+    {
+        return convert_batch(batch_dir, extension, options, argc - 1, argv + 1);
+    }
+    if (rebuild && batch_dir == nullptr && !usage && size_w == 0 && argc == 3)
+    {
+        return ::rebuild_directory(argv[1], argv[2], extension, options);
+    }
+    svg::ImageFormat image_format = svg::ImageFormat::png;
+    if (argc > 2)
+    {
+        std::string name = file_format ? std::string("out.") + file_format : argv[2];
+        image_format = svg::PNGImage::format_for(name);
+        usage = usage || (file_format && image_format == svg::ImageFormat::png &&
+                          std::strcmp(file_format, "png") != 0);
+    }
+    if (usage || batch_dir != nullptr || rebuild || timeout > 0 || (argc != 3 && argc != 7))
+    {
+        std::cout << "Usage: svgtopng [--transparent] [--format png|ppm|qoi|raw] [--size WxH] in_file.svg out_file.png [x y width height]" << std::endl
+                  << "       svgtopng [--transparent] [--format png|ppm|qoi|raw] [--timeout seconds] --batch out_dir in_file.svg..." << std::endl
+                  << "       svgtopng [--transparent] [--format png|ppm|qoi|raw] [--timeout seconds] --rebuild in_dir out_dir" << std::endl;
+        return 0;
+    }
+    // Saves a rendering, shrunk first if asked to.
+    auto save = [&](const svg::PNGImage &img)
+    {
+        if (size_w == 0)
+        {
+            img.save(argv[2], image_format);
+            return;
+        }
+        svg::PNGImage small(size_w, size_h, format);
+        img.downscale(small);
+        small.save(argv[2], image_format);
+    };
+    if (argc == 3 && format == svg::PixelFormat::rgb && file_format == nullptr && size_w == 0)
     {
         std::cout << "Performing conversion ... " << argv[1] << " --> " << argv[2] << std::endl;
         svg::convert(argv[1], argv[2]);
         std::cout << "Done!" << std::endl;
     }
+    else if (argc == 3)
+    {
+        std::cout << "Performing conversion ... " << argv[1] << " --> " << argv[2] << std::endl;
+        svg::Document doc(argv[1]);
+        svg::PNGImage img(doc.width(), doc.height(), format);
+        doc.draw(img);
+        save(img);
+        std::cout << "Done!" << std::endl;
+    }
+    else
+    {
+        int x = std::atoi(argv[3]), y = std::atoi(argv[4]);
+        int w = std::atoi(argv[5]), h = std::atoi(argv[6]);
+        if (w <= 0 || h <= 0)
+        {
+            std::cout << "Region width and height must be positive" << std::endl;
+            return 1;
+        }
+        std::cout << "Performing region conversion ... " << argv[1] << " --> " << argv[2] << std::endl;
+        svg::Document doc(argv[1]);
+        svg::PNGImage img(w, h, format);
+        doc.render_region(x, y, img);
+        save(img);
+        std::cout << "Done!" << std::endl;
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -1,14 +1,28 @@
-
 // Project file headers
+#include "Batch.hpp"
+#include "Document.hpp"
+#include "Scene.hpp"
 #include "SVGElements.hpp"
+#include "external/stb/stb_image.h"
 
 // C++ library headers
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <cassert>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <iterator>
 #include <fstream>
@@ -16,6 +30,7 @@ using namespace std;
 
 // POSIX headers
 #include <unistd.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <dirent.h>
@@ -24,6 +39,1008 @@ namespace svg
 {
     const string LOG_FILE_NAME = "test_log.txt";
 
+    //! Summary of the differences between an expected and an actual image.
+    struct ImageDiff
+    {
+        int differing_pixels = 0;
+        int max_channel_delta = 0;
+        long total_channel_delta = 0;
+        Box region = EMPTY_BOX;
+    };
+
+    //! A test of behavior that a golden image cannot show. It writes what
+    //! went wrong to the log and returns whether it passed.
+    typedef bool (*Check)(const string &root_path, ostream &log);
+
+    //! Logs a failed expectation.
+    //! @return The condition.
+    bool expect(bool condition, const string &what, ostream &log)
+    {
+        if (!condition)
+        {
+            log << "expected " << what << endl;
+        }
+        return condition;
+    }
+
+    //! Parses a document from text, and returns the message of the error
+    //! it throws, or an empty string.
+    string parse_error(const string &text, const Limits &limits = Limits())
+    {
+        try
+        {
+            Document doc("check.svg", text.data(), text.size(), limits);
+        }
+        catch (const runtime_error &e)
+        {
+            return e.what();
+        }
+        return "";
+    }
+
+    //! A file of nested use elements that each copy the previous level ten
+    //! times, so that the last one stands for 10^9 polygons.
+    string use_bomb()
+    {
+        string text = "<svg width=\"10\" height=\"10\"><defs>"
+                      "<polygon id=\"l0\" points=\"0,0 1,0 1,1\" fill=\"red\"/>";
+        for (int level = 1; level <= 9; level++)
+        {
+            text += "<g id=\"l" + to_string(level) + "\">";
+            for (int i = 0; i < 10; i++)
+            {
+                text += "<use href=\"#l" + to_string(level - 1) + "\"/>";
+            }
+            text += "</g>";
+        }
+        return text + "</defs><use href=\"#l9\"/></svg>";
+    }
+
+    bool check_use_expansion(const string &, ostream &log)
+    {
+        // Copies count against the limits, so the file fails before it
+        // runs out of memory.
+        string error = parse_error(use_bomb());
+        bool ok = expect(error.find("more than") != string::npos,
+                         "a limit error for nested uses, got \"" + error + "\"", log);
+        Limits limits;
+        limits.max_elements = 100;
+        string text = "<svg width=\"10\" height=\"10\"><defs><g id=\"g\">";
+        for (int i = 0; i < 60; i++)
+        {
+            text += "<rect width=\"1\" height=\"1\" fill=\"red\"/>";
+        }
+        text += "</g></defs><use href=\"#g\"/></svg>";
+        error = parse_error(text, limits);
+        ok = expect(error.find("more than 100 elements") != string::npos,
+                    "a copy of 61 elements to exceed 100 with the 63 parsed, got \"" +
+                        error + "\"", log) && ok;
+        limits.max_elements = 200;
+        return expect(parse_error(text, limits).empty(),
+                      "124 elements to fit in 200", log) && ok;
+    }
+
+    bool check_limits(const string &, ostream &log)
+    {
+        // Each limit rejects a document just over it, with an error naming
+        // it, and accepts one just under it.
+        auto rejects = [&log](const string &text, const Limits &limits, const string &what) {
+            string error = parse_error(text, limits);
+            return expect(error.find(what) != string::npos,
+                          "\"" + what + "\", got \"" + error + "\"", log);
+        };
+        auto accepts = [&log](const string &text, const Limits &limits, const string &what) {
+            string error = parse_error(text, limits);
+            return expect(error.empty(), what + " to be accepted, got \"" + error + "\"", log);
+        };
+        Limits limits;
+        bool ok = rejects("<svg width=\"100000\" height=\"100000\"/>", limits,
+                          "more than 268435456 pixels");
+        ok = accepts("<svg width=\"16384\" height=\"16384\"/>", limits, "2^28 pixels") && ok;
+        ok = rejects("<svg width=\"-10\" height=\"10\"/>", limits, "negative width") && ok;
+        ok = rejects("<svg width=\"0\" height=\"10\"/>", limits, "zero or negative width") && ok;
+        ok = rejects("<svg height=\"10\"/>", limits, "missing, zero") && ok;
+
+        limits.max_elements = 10;
+        string rects;
+        for (int i = 0; i < 10; i++)
+        {
+            rects += "<rect width=\"1\" height=\"1\"/>";
+        }
+        ok = accepts("<svg width=\"10\" height=\"10\">" + rects + "</svg>", limits,
+                     "10 elements") && ok;
+        ok = rejects("<svg width=\"10\" height=\"10\"><g>" + rects + "</g></svg>", limits,
+                     "more than 10 elements") && ok;
+
+        limits = Limits();
+        limits.max_depth = 20;
+        string nested = "<svg width=\"10\" height=\"10\">";
+        for (int i = 0; i < 20; i++)
+        {
+            nested += "<g>";
+        }
+        for (int i = 0; i < 20; i++)
+        {
+            nested += "</g>";
+        }
+        ok = accepts(nested + "</svg>", limits, "20 levels") && ok;
+        ok = rejects("<svg width=\"10\" height=\"10\"><g>" + nested.substr(nested.find('>') + 1) +
+                         "</g></svg>",
+                     limits, "more than 20 levels of nesting") && ok;
+
+        limits = Limits();
+        limits.max_vertices = 100;
+        string points;
+        for (int i = 0; i < 100; i++)
+        {
+            points += to_string(i % 10) + "," + to_string(i / 10) + " ";
+        }
+        string polygon = "<polygon points=\"" + points + "\"/>";
+        ok = accepts("<svg width=\"10\" height=\"10\">" + polygon + "</svg>", limits,
+                     "100 vertices") && ok;
+        ok = rejects("<svg width=\"10\" height=\"10\">" + polygon + "<line/></svg>", limits,
+                     "more than 100 vertices") && ok;
+        // Curves flattened again under a scale count too.
+        ok = rejects("<svg width=\"10\" height=\"10\"><path transform=\"scale(1000)\" "
+                     "d=\"M 0 0 A 5 5 0 1 1 0 1 Z\"/></svg>",
+                     limits, "more than 100 vertices") && ok;
+        return ok;
+    }
+
+    //! Reads a whole file.
+    string read_file(const string &path)
+    {
+        ifstream in(path, ios::binary);
+        return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+
+    bool check_svgz_size(const string &root_path, ostream &log)
+    {
+        string svgz = read_file(root_path + "/input/svgz_1.svgz");
+        if (!expect(svgz.size() > 18, "input/svgz_1.svgz", log))
+        {
+            return false;
+        }
+        // A trailer claiming 2 GB sizes nothing: the file reads as usual.
+        string lie = svgz;
+        lie.replace(lie.size() - 4, 4, "\xf0\xff\xff\x7f");
+        bool ok = expect(parse_error(lie).empty(), "a lying size trailer to be ignored", log);
+        // Too short a claim only makes the buffer grow.
+        string short_claim = svgz;
+        short_claim.replace(short_claim.size() - 4, 4, string("\x0a\0\0\0", 4));
+        ok = expect(parse_error(short_claim).empty(), "a short size trailer to be ignored", log) && ok;
+        Limits limits;
+        limits.max_inflated_bytes = 100;
+        string error = parse_error(svgz, limits);
+        return expect(error.find("over 100 bytes inflated") != string::npos,
+                      "the inflated size limit, got \"" + error + "\"", log) && ok;
+    }
+
+    //! Writes a whole file.
+    void write_file(const string &path, const string &text)
+    {
+        ofstream(path, ios::binary) << text;
+    }
+
+    //! Whether a file exists.
+    bool file_exists(const string &path)
+    {
+        return ::access(path.c_str(), F_OK) == 0;
+    }
+
+    //! A new directory for the files of a check, removed with its files and
+    //! subdirectories when the check is done.
+    class ScratchDir
+    {
+    public:
+        ScratchDir()
+        {
+            char name[] = "/tmp/svgtopng-check-XXXXXX";
+            if (::mkdtemp(name) == nullptr)
+            {
+                throw runtime_error("Unable to create a directory in /tmp");
+            }
+            path_ = name;
+        }
+        ~ScratchDir() { remove_all(path_); }
+        const string &path() const { return path_; }
+
+    private:
+        static void remove_all(const string &path)
+        {
+            ::DIR *directory = ::opendir(path.c_str());
+            ::dirent *entry;
+            while (directory != nullptr && (entry = ::readdir(directory)) != nullptr)
+            {
+                string name = entry->d_name;
+                if (entry->d_type == DT_DIR && name != "." && name != "..")
+                {
+                    remove_all(path + "/" + name);
+                }
+                else if (entry->d_type != DT_DIR)
+                {
+                    ::remove((path + "/" + name).c_str());
+                }
+            }
+            if (directory != nullptr)
+            {
+                ::closedir(directory);
+            }
+            ::rmdir(path.c_str());
+        }
+        string path_;
+    };
+
+    bool check_batch_errors(const string &root_path, ostream &log)
+    {
+        // An unreadable and a malformed file fail on their own; the files
+        // around them are converted.
+        ScratchDir dir;
+        write_file(dir.path() + "/bad.svg", "<svg width=\"10\" height=\"10\"><rect");
+        vector<BatchJob> jobs = {
+            {root_path + "/input/rect_1.svg", dir.path() + "/0.png"},
+            {dir.path() + "/missing.svg", dir.path() + "/1.png"},
+            {root_path + "/input/circle_1.svg", dir.path() + "/2.png"},
+            {dir.path() + "/bad.svg", dir.path() + "/3.png"},
+            {root_path + "/input/svgz_1.svgz", dir.path() + "/4.ppm"},
+        };
+        BatchReport report = convert_batch(jobs);
+        vector<size_t> failed = report.failed;
+        sort(failed.begin(), failed.end());
+        bool ok = expect(failed == vector<size_t>({1, 3}) && report.errors.size() == 2,
+                         "jobs 1 and 3, and only them, to fail", log);
+        ok = expect(report.converted == 3, "3 files converted", log) && ok;
+        for (size_t i : {0, 2, 4})
+        {
+            ok = expect(file_exists(jobs[i].output), jobs[i].output + " to be written", log) && ok;
+        }
+        return ok;
+    }
+
+    bool check_rebuild_names(const string &root_path, ostream &log)
+    {
+        ScratchDir dir;
+        string in = dir.path() + "/in", out = dir.path() + "/out";
+        ::mkdir(in.c_str(), 0777);
+        ::mkdir(out.c_str(), 0777);
+        string svg = read_file(root_path + "/input/rect_1.svg");
+        write_file(in + "/a.svg", svg);
+        write_file(in + "/a.svgz", read_file(root_path + "/input/svgz_1.svgz"));
+        write_file(in + "/b.svg", svg);
+        // A manifest naming files outside the output directory, or that are
+        // not images, must not make them go.
+        write_file(dir.path() + "/victim.png", "keep");
+        write_file(out + "/notes.txt", "keep");
+        write_file(out + "/" + REBUILD_MANIFEST,
+                   "svgtopng-manifest 1\noptions extension=png format=rgb\n"
+                   "0\tc.svg\t../victim.png\n0\td.svg\tnotes.txt\n"
+                   "0\te.svg\t..\n0\tf.svg\tgone.png\n");
+        write_file(out + "/gone.png", "stale");
+        RebuildReport report = rebuild_directory(in, out, "png");
+        bool ok = expect(file_exists(dir.path() + "/victim.png"), "../victim.png to be kept", log);
+        ok = expect(file_exists(out + "/notes.txt"), "notes.txt to be kept", log) && ok;
+        ok = expect(!file_exists(out + "/gone.png") && report.removed == 1,
+                    "gone.png, and only it, to be removed", log) && ok;
+        // a.svg and a.svgz would both make a.png: the second is reported.
+        ok = expect(report.conflicts.size() == 1 &&
+                        report.conflicts[0].find("a.svgz") != string::npos,
+                    "a conflict for a.svgz", log) && ok;
+        return expect(report.batch.converted == 2 && report.batch.errors.empty(),
+                      "a.svg and b.svg to be converted", log) && ok;
+    }
+
+    bool check_rebuild(const string &root_path, ostream &log)
+    {
+        ScratchDir dir;
+        string in = dir.path() + "/in", out = dir.path() + "/out";
+        ::mkdir(in.c_str(), 0777);
+        string rect = read_file(root_path + "/input/rect_1.svg");
+        write_file(in + "/a.svg", rect);
+        write_file(in + "/b.svg", read_file(root_path + "/input/circle_1.svg"));
+        write_file(in + "/c.svg", rect);
+        BatchOptions options;
+        auto rebuild = [&](const string &extension, size_t converted, size_t unchanged,
+                           size_t removed, const string &what) {
+            RebuildReport r = rebuild_directory(in, out, extension, options);
+            bool passed = r.batch.converted == converted && r.batch.errors.empty() &&
+                          r.unchanged == unchanged && r.removed == removed;
+            return expect(passed, what + ": " + to_string(converted) + " converted, " +
+                                      to_string(unchanged) + " unchanged, " +
+                                      to_string(removed) + " removed, got " +
+                                      to_string(r.batch.converted) + ", " +
+                                      to_string(r.unchanged) + ", " + to_string(r.removed),
+                          log);
+        };
+        bool ok = rebuild("png", 3, 0, 0, "first rebuild");
+        ok = rebuild("png", 0, 3, 0, "second rebuild") && ok;
+        // A changed file is converted again, and only it: its image is the
+        // only one replaced.
+        write_file(out + "/b.png", "old");
+        write_file(out + "/c.png", "old");
+        write_file(in + "/c.svg", rect + "\n");
+        ok = rebuild("png", 1, 2, 0, "rebuild after changing c.svg") && ok;
+        ok = expect(read_file(out + "/b.png") == "old" && read_file(out + "/c.png") != "old",
+                    "only c.png to be written again", log) && ok;
+        // A missing image is written again.
+        ::remove((out + "/b.png").c_str());
+        ok = rebuild("png", 1, 2, 0, "rebuild after removing b.png") && ok;
+        // The image of a deleted file goes.
+        ::remove((in + "/a.svg").c_str());
+        ok = rebuild("png", 0, 2, 1, "rebuild after removing a.svg") && ok;
+        ok = expect(!file_exists(out + "/a.png"), "a.png to be removed", log) && ok;
+        // Another file format or pixel format changes every image; images
+        // in the old file format are stale.
+        ok = rebuild("ppm", 2, 0, 2, "rebuild to ppm") && ok;
+        ok = expect(file_exists(out + "/b.ppm") && !file_exists(out + "/b.png"),
+                    "b.ppm to replace b.png", log) && ok;
+        options.format = PixelFormat::rgba;
+        return rebuild("ppm", 2, 0, 0, "rebuild to rgba") && ok;
+    }
+
+    //! Decodes a QOI file, following the specification rather than the
+    //! encoder, into packed pixels.
+    //! @return false if it is not a valid QOI file.
+    bool decode_qoi(const string &file, int &w, int &h, int &channels,
+                    vector<unsigned char> &out)
+    {
+        const unsigned char *p = (const unsigned char *)file.data();
+        const unsigned char *end = p + file.size() - 8;
+        if (file.size() < 22 || file.compare(0, 4, "qoif") != 0)
+        {
+            return false;
+        }
+        auto get32 = [](const unsigned char *q) {
+            return (int)((uint32_t)q[0] << 24 | (uint32_t)q[1] << 16 | (uint32_t)q[2] << 8 | q[3]);
+        };
+        w = get32(p + 4);
+        h = get32(p + 8);
+        channels = p[12];
+        p += 14;
+        unsigned char seen[64][4] = {}, px[4] = {0, 0, 0, 255};
+        int run = 0;
+        out.clear();
+        for (size_t i = 0, n = (size_t)w * h; i < n; i++)
+        {
+            if (run > 0)
+            {
+                run--;
+            }
+            else if (p >= end)
+            {
+                return false;
+            }
+            else
+            {
+                int b = *p++;
+                if (b == 0xFE || b == 0xFF)
+                {
+                    int k = b == 0xFE ? 3 : 4;
+                    if (end - p < k)
+                    {
+                        return false;
+                    }
+                    ::memcpy(px, p, k);
+                    p += k;
+                }
+                else if (b < 0x40)
+                {
+                    ::memcpy(px, seen[b], 4);
+                }
+                else if (b < 0x80)
+                {
+                    px[0] += ((b >> 4) & 3) - 2;
+                    px[1] += ((b >> 2) & 3) - 2;
+                    px[2] += (b & 3) - 2;
+                }
+                else if (b < 0xC0)
+                {
+                    if (p >= end)
+                    {
+                        return false;
+                    }
+                    int dg = (b & 63) - 32, c = *p++;
+                    px[0] += dg + (c >> 4) - 8;
+                    px[1] += dg;
+                    px[2] += dg + (c & 15) - 8;
+                }
+                else
+                {
+                    run = b & 63;
+                }
+            }
+            ::memcpy(seen[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+            out.insert(out.end(), px, px + channels);
+        }
+        return p == end && ::memcmp(end, "\0\0\0\0\0\0\0\1", 8) == 0;
+    }
+
+    //! Reads a binary PPM file (P6, 8 bits per channel) into packed pixels.
+    //! @return false if it is not one.
+    bool decode_ppm(const string &file, int &w, int &h, vector<unsigned char> &out)
+    {
+        istringstream in(file);
+        string magic;
+        int max_value;
+        if (!(in >> magic >> w >> h >> max_value) || magic != "P6" || max_value != 255 ||
+            in.get() != '\n')
+        {
+            return false;
+        }
+        size_t start = (size_t)in.tellg();
+        if (file.size() - start != (size_t)w * h * 3)
+        {
+            return false;
+        }
+        out.assign(file.begin() + start, file.end());
+        return true;
+    }
+
+    //! Loads an image with stb_image, with its own number of channels.
+    bool load_image(const string &path, int &w, int &h, int &channels,
+                    vector<unsigned char> &out)
+    {
+        unsigned char *data = ::stbi_load(path.c_str(), &w, &h, &channels, 0);
+        if (data == nullptr)
+        {
+            return false;
+        }
+        out.assign(data, data + (size_t)w * h * channels);
+        ::stbi_image_free(data);
+        return true;
+    }
+
+    bool check_image_formats(const string &root_path, ostream &log)
+    {
+        ScratchDir dir;
+        bool ok = true;
+        for (const char *input : {"gradient_1.svg", "opacity_1.svg"})
+        {
+            Document doc(root_path + "/input/" + input);
+            for (PixelFormat format : {PixelFormat::rgb, PixelFormat::rgba})
+            {
+                PNGImage img(doc.width(), doc.height(), format);
+                doc.draw(img);
+                int w = img.width(), h = img.height();
+                int channels = format == PixelFormat::rgb ? 3 : 4;
+                string base = dir.path() + "/" + input + (channels == 3 ? ".rgb" : ".rgba");
+                for (const char *extension : {".png", ".ppm", ".qoi", ".raw"})
+                {
+                    img.save(base + extension);
+                }
+                // The colors as drawn: premultiplied, i.e. over black.
+                vector<unsigned char> colors;
+                for (int y = 0; y < h; y++)
+                {
+                    for (int x = 0; x < w; x++)
+                    {
+                        Color c = img.at(x, y);
+                        colors.insert(colors.end(), {c.red, c.green, c.blue});
+                    }
+                }
+                // The PNG, written by stb_image_write, is the reference for
+                // the alpha channel, which cannot be read from the image.
+                int w2, h2, n;
+                vector<unsigned char> png, pixels;
+                string what = base.substr(dir.path().size() + 1);
+                if (!expect(load_image(base + ".png", w2, h2, n, png) && w2 == w && h2 == h &&
+                                n == channels,
+                            what + ".png to load", log))
+                {
+                    ok = false;
+                    continue;
+                }
+                bool close = true;
+                for (size_t i = 0, k = 0; i < colors.size(); i += 3, k += channels)
+                {
+                    int a = channels == 4 ? png[k + 3] : 255;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        close = close && abs(png[k + c] * a / 255 - colors[i + c]) <= 1;
+                    }
+                }
+                ok = expect(close, what + ".png to have the colors drawn", log) && ok;
+                ok = expect(decode_ppm(read_file(base + ".ppm"), w2, h2, pixels) && w2 == w &&
+                                h2 == h && pixels == colors,
+                            what + ".ppm to have the colors drawn", log) && ok;
+                string raw = read_file(base + ".raw");
+                ok = expect(raw.size() == png.size() &&
+                                ::memcmp(raw.data(), png.data(), raw.size()) == 0,
+                            what + ".raw to have the pixels of the PNG", log) && ok;
+                ok = expect(decode_qoi(read_file(base + ".qoi"), w2, h2, n, pixels) && w2 == w &&
+                                h2 == h && n == channels && pixels == png,
+                            what + ".qoi to decode to the pixels of the PNG", log) && ok;
+                // Failing to write throws, whatever the format.
+                for (const char *extension : {".png", ".ppm", ".qoi", ".raw"})
+                {
+                    bool thrown = false;
+                    try
+                    {
+                        img.save(dir.path() + "/missing/image" + extension);
+                    }
+                    catch (const runtime_error &)
+                    {
+                        thrown = true;
+                    }
+                    ok = expect(thrown, string("an error writing ") + extension +
+                                            " into a missing directory",
+                                log) && ok;
+                }
+            }
+        }
+        return ok;
+    }
+
+    //! Names of the files of the input directory, sorted.
+    vector<string> input_files(const string &root_path)
+    {
+        vector<string> names;
+        ::DIR *directory = ::opendir((root_path + "/input").c_str());
+        ::dirent *entry;
+        while (directory != nullptr && (entry = ::readdir(directory)) != nullptr)
+        {
+            if (entry->d_type == DT_REG)
+            {
+                names.push_back(entry->d_name);
+            }
+        }
+        if (directory != nullptr)
+        {
+            ::closedir(directory);
+        }
+        sort(names.begin(), names.end());
+        return names;
+    }
+
+    //! Compares a region of an image with another image placed at (x, y)
+    //! in it, over the pixels they share, and logs the first difference.
+    bool same_region(const PNGImage &full, const PNGImage &part, int x, int y,
+                     const string &what, ostream &log)
+    {
+        int differing = 0;
+        for (int j = max(0, -y); j < part.height() && y + j < full.height(); j++)
+        {
+            const Color *f = full.row(y + j), *p = part.row(j);
+            for (int i = max(0, -x); i < part.width() && x + i < full.width(); i++)
+            {
+                const Color &a = f[x + i], &b = p[i];
+                if (a.red != b.red || a.green != b.green || a.blue != b.blue)
+                {
+                    if (differing++ == 0)
+                    {
+                        log << what << ": first difference at (" << x + i << ' '
+                            << y + j << ")" << endl;
+                    }
+                }
+            }
+        }
+        if (differing > 0)
+        {
+            log << what << ": " << differing << " pixels differ" << endl;
+        }
+        return differing == 0;
+    }
+
+    //! Replaces the first occurrence of a string.
+    string replaced(string text, const string &from, const string &to)
+    {
+        size_t at = text.find(from);
+        return at == string::npos ? text : text.replace(at, from.size(), to);
+    }
+
+    bool check_scene_render(const string &, ostream &log)
+    {
+        // Changes made through a scene, repainting only dirty regions, must
+        // give the image of a file with the same changes, drawn whole.
+        ScratchDir dir;
+        string svg =
+            "<svg width=\"200\" height=\"150\" xmlns=\"http://www.w3.org/2000/svg\">"
+            "<defs><linearGradient id=\"g\"><stop offset=\"0\" stop-color=\"yellow\"/>"
+            "<stop offset=\"1\" stop-color=\"purple\"/></linearGradient></defs>"
+            "<rect id=\"bg\" x=\"10\" y=\"10\" width=\"180\" height=\"130\" fill=\"url(#g)\"/>"
+            "<circle id=\"c\" cx=\"60\" cy=\"60\" r=\"40\" fill=\"red\"/>"
+            "<polygon id=\"p\" points=\"80,20 180,40 120,120\" fill=\"green\" "
+            "fill-opacity=\"0.5\" stroke=\"black\" stroke-width=\"3\"/>"
+            "<g opacity=\"0.6\"><rect id=\"r\" x=\"20\" y=\"100\" width=\"60\" "
+            "height=\"30\" fill=\"navy\"/></g>"
+            "<path id=\"a\" d=\"M 150 100 A 20 20 0 1 1 150 101 Z\" fill=\"teal\"/>"
+            "<polyline id=\"l\" points=\"10,10 190,140\" stroke=\"orange\" stroke-width=\"5\"/>"
+            "</svg>";
+        write_file(dir.path() + "/scene.svg", svg);
+        Scene scene(dir.path() + "/scene.svg");
+        auto compare = [&](const string &expected_svg, const string &what) {
+            write_file(dir.path() + "/expected.svg", expected_svg);
+            Document doc(dir.path() + "/expected.svg");
+            PNGImage expected(doc.width(), doc.height());
+            doc.draw(expected);
+            scene.render();
+            return expect(scene.dirty().empty(), "no dirty region after render", log) &&
+                   same_region(expected, scene.image(), 0, 0, what, log);
+        };
+        scene.set_color("c", {0, 0, 255});
+        scene.set_points("p", {{100, 30}, {190, 90}, {90, 140}});
+        svg = replaced(svg, "fill=\"red\"", "fill=\"blue\"");
+        svg = replaced(svg, "80,20 180,40 120,120", "100,30 190,90 90,140");
+        bool ok = compare(svg, "color and points");
+        scene.transform("r", "translate(70,-60)", {0, 0});
+        scene.transform("a", "scale(0.5)", {0, 0});
+        scene.set_color("l", {128, 0, 128});
+        svg = replaced(svg, "<g opacity=\"0.6\"><rect id=\"r\"",
+                       "<g opacity=\"0.6\"><rect id=\"r\" transform=\"translate(70,-60)\"");
+        svg = replaced(svg, "<path id=\"a\"", "<path id=\"a\" transform=\"scale(0.5)\"");
+        svg = replaced(svg, "stroke=\"orange\"", "stroke=\"purple\"");
+        return compare(svg, "transforms and stroke color") && ok;
+    }
+
+    bool check_cancel(const string &root_path, ostream &log)
+    {
+        Document doc(root_path + "/input/lion.svg");
+        auto cancelled = [&doc](CancelToken &token) {
+            PNGImage img(doc.width(), doc.height());
+            img.set_cancel(&token);
+            try
+            {
+                doc.draw(img);
+            }
+            catch (const Cancelled &)
+            {
+                return true;
+            }
+            return false;
+        };
+        // A cancelled token, or a deadline that has passed, stops drawing.
+        CancelToken token;
+        token.cancel();
+        bool ok = expect(cancelled(token), "a cancelled token to stop drawing", log);
+        CancelToken past;
+        past.set_deadline(1e-9);
+        this_thread::sleep_for(chrono::milliseconds(1));
+        ok = expect(cancelled(past), "a passed deadline to stop drawing", log) && ok;
+        // A deadline far away changes nothing.
+        CancelToken future;
+        future.set_deadline(600);
+        PNGImage expected(doc.width(), doc.height()), img(doc.width(), doc.height());
+        doc.draw(expected);
+        img.set_cancel(&future);
+        doc.draw(img);
+        ok = same_region(expected, img, 0, 0, "drawing with a distant deadline", log) && ok;
+        // Another thread may cancel a drawing in progress.
+        CancelToken later;
+        thread canceller([&later]() {
+            this_thread::sleep_for(chrono::milliseconds(20));
+            later.cancel();
+        });
+        bool stopped = false;
+        for (int i = 0; i < 100000 && !stopped; i++)
+        {
+            stopped = cancelled(later);
+        }
+        canceller.join();
+        ok = expect(stopped, "a cancel from another thread to stop drawing", log) && ok;
+        // A stroke cancelled halfway leaves nothing behind for the next shape.
+        ScratchDir strokes;
+        write_file(strokes.path() + "/thick.svg",
+                   "<svg width=\"40\" height=\"40\"><polyline points=\"5,5 35,35\" "
+                   "fill=\"none\" stroke=\"red\" stroke-width=\"6\"/></svg>");
+        write_file(strokes.path() + "/thin.svg",
+                   "<svg width=\"40\" height=\"40\"><polyline points=\"5,35 35,5\" "
+                   "fill=\"none\" stroke=\"blue\" stroke-width=\"4\"/></svg>");
+        Document thick(strokes.path() + "/thick.svg"), thin(strokes.path() + "/thin.svg");
+        PNGImage interrupted(40, 40), fresh(40, 40), after(40, 40);
+        thin.draw(fresh);
+        interrupted.set_cancel(&token);
+        bool stroke_stopped = false;
+        try
+        {
+            thick.element(0).draw(interrupted);
+        }
+        catch (const Cancelled &)
+        {
+            stroke_stopped = true;
+        }
+        ok = expect(stroke_stopped, "a cancelled token to stop a stroke", log) && ok;
+        thin.draw(after);
+        ok = same_region(fresh, after, 0, 0, "a stroke after a cancelled one", log) && ok;
+        // A batch timeout makes the file fail, not the batch.
+        BatchOptions options;
+        options.timeout = 1e-9;
+        ScratchDir dir;
+        vector<BatchJob> jobs = {{root_path + "/input/lion.svg", dir.path() + "/lion.png"}};
+        BatchReport report = convert_batch(jobs, options);
+        return expect(report.failed.size() == 1 &&
+                          report.errors[0].find("cancelled") != string::npos,
+                      "a batch timeout to fail the file", log) && ok;
+    }
+
+    bool check_region_render(const string &root_path, ostream &log)
+    {
+        // Every input, drawn whole and as regions that clip it in
+        // different ways, must give the same pixels.
+        bool ok = true;
+        for (const string &name : input_files(root_path))
+        {
+            Document doc(root_path + "/input/" + name);
+            int w = doc.width(), h = doc.height();
+            PNGImage full(w, h);
+            doc.draw(full);
+            const Box regions[] = {
+                {0, h / 2, w - 1, h / 2 + h / 4},     // A band across
+                {w / 3, h / 3, w - 1, h - 1},          // Bottom right
+                {0, 0, w / 2 - 1, h / 2 - 1},          // Top left
+                {w / 4, h / 5, w / 4 + 16, h / 5},     // One row
+                {-20, h - 30, w / 2, h + 20},          // Across the edges
+            };
+            for (const Box &r : regions)
+            {
+                PNGImage part(r.x_max - r.x_min + 1, r.y_max - r.y_min + 1);
+                doc.render_region(r.x_min, r.y_min, part);
+                ok = same_region(full, part, r.x_min, r.y_min,
+                                 name + " region " + to_string(r.x_min) + " " +
+                                     to_string(r.y_min),
+                                 log) && ok;
+            }
+        }
+
+        // Ellipses round their center and radii separately, reaching one
+        // pixel past their exact bounds, which regions just beyond them
+        // must still draw.
+        string svg = "<svg width=\"30\" height=\"30\">"
+                     "<ellipse cx=\"10.5\" cy=\"10.5\" rx=\"4.5\" ry=\"4.5\" fill=\"red\"/>"
+                     "<ellipse cx=\"20.5\" cy=\"20.5\" rx=\"4.5\" ry=\"2.5\" "
+                     "transform=\"rotate(30 20.5 20.5)\" fill=\"blue\"/></svg>";
+        Document ellipses("ellipses.svg", svg.data(), svg.size());
+        PNGImage full(30, 30);
+        ellipses.draw(full);
+        for (int edge = 4; edge <= 26; edge++)
+        {
+            const Box regions[] = {{edge, 0, 29, 29}, {0, edge, 29, 29},
+                                   {0, 0, edge, 29}, {0, 0, 29, edge}};
+            for (const Box &r : regions)
+            {
+                PNGImage part(r.x_max - r.x_min + 1, r.y_max - r.y_min + 1);
+                ellipses.render_region(r.x_min, r.y_min, part);
+                ok = same_region(full, part, r.x_min, r.y_min,
+                                 "ellipses region " + to_string(r.x_min) + " " +
+                                     to_string(r.y_min) + " " + to_string(r.x_max) + " " +
+                                     to_string(r.y_max),
+                                 log) && ok;
+            }
+        }
+        return ok;
+    }
+
+    bool check_spatial_index(const string &, ostream &log)
+    {
+        // Queries must find exactly the boxes a linear scan finds, over
+        // several levels of the tree, with empty and far away boxes.
+        mt19937 random(7);
+        auto coordinate = [&random](int range) { return (int)(random() % range) - range / 8; };
+        vector<Box> boxes;
+        for (int i = 0; i < 5000; i++)
+        {
+            int x = coordinate(2000), y = coordinate(2000);
+            int w = i % 50 == 0 ? -1 : (int)(random() % 60), h = (int)(random() % 60);
+            boxes.push_back({x, y, x + w, y + h});
+        }
+        boxes.push_back({100000, 100000, 100001, 100001});
+        SpatialIndex index(boxes);
+        bool ok = true;
+        vector<size_t> hits, expected;
+        for (int q = 0; q < 200 && ok; q++)
+        {
+            int x = coordinate(2200), y = coordinate(2200), size = (int)(random() % 400);
+            Box region = {x, y, x + size, y + size / 2};
+            hits.clear();
+            index.query(region, hits);
+            expected.clear();
+            for (size_t i = 0; i < boxes.size(); i++)
+            {
+                if (!boxes[i].empty() && boxes[i].intersects(region))
+                {
+                    expected.push_back(i);
+                }
+            }
+            ok = expect(hits == expected, "query " + to_string(q) + " to find the " +
+                                              to_string(expected.size()) + " boxes a scan finds",
+                        log);
+        }
+        hits.clear();
+        index.query({-1000, -1000, 100000, 100000}, hits);
+        ok = expect(hits.size() == boxes.size() - 100, "a query of everything to find the " +
+                                                         to_string(boxes.size() - 100) +
+                                                         " boxes that are not empty",
+                    log) && ok;
+
+        // A document with many overlapping shapes, which makes a deep tree,
+        // drawn as tiles.
+        string svg = "<svg width=\"300\" height=\"200\" xmlns=\"http://www.w3.org/2000/svg\">";
+        for (int i = 0; i < 3000; i++)
+        {
+            int x = (int)(random() % 320) - 10, y = (int)(random() % 220) - 10;
+            svg += "<rect x=\"" + to_string(x) + "\" y=\"" + to_string(y) + "\" width=\"" +
+                   to_string(random() % 12 + 1) + "\" height=\"" + to_string(random() % 12 + 1) +
+                   "\" fill=\"#" + to_string(100000 + random() % 900000) + "\"/>";
+        }
+        svg += "</svg>";
+        // The same shapes wrapped in groups, whose shapes are indexed one
+        // by one, with a translucent group and uses of them on top.
+        string grouped = replaced(svg, "xmlns=\"http://www.w3.org/2000/svg\">",
+                                  "xmlns=\"http://www.w3.org/2000/svg\"><g id=\"all\"><g>");
+        grouped = replaced(grouped, "</svg>",
+                           "</g></g><g opacity=\"0.5\"><rect x=\"40\" y=\"30\" width=\"90\" "
+                           "height=\"70\" fill=\"red\"/><circle cx=\"120\" cy=\"90\" r=\"40\" "
+                           "fill=\"blue\"/></g><use href=\"#all\" transform=\"rotate(90)\" "
+                           "transform-origin=\"150 100\"/>"
+                           "</svg>");
+        for (const string &text : {svg, grouped})
+        {
+            Document doc("tiles.svg", text.data(), text.size());
+            string what = text == svg ? "tile " : "grouped tile ";
+            PNGImage full(doc.width(), doc.height());
+            doc.draw(full);
+            for (int y = -16; y < doc.height(); y += 48)
+            {
+                for (int x = -16; x < doc.width(); x += 64)
+                {
+                    PNGImage tile(64, 48);
+                    doc.render_region(x, y, tile);
+                    ok = same_region(full, tile, x, y, what + to_string(x) + " " + to_string(y),
+                                     log) && ok;
+                }
+            }
+        }
+        return ok;
+    }
+
+    bool check_colors(const string &, ostream &log)
+    {
+        // Functional colors clamp their components; numbers strtod reads
+        // but that are not finite make the color invalid.
+        auto parses_to = [](const char *text, const Color &expected) {
+            Color c = parse_color(text);
+            return c.red == expected.red && c.green == expected.green &&
+                   c.blue == expected.blue;
+        };
+        auto invalid = [](const char *text) {
+            try
+            {
+                parse_color(text);
+            }
+            catch (const runtime_error &)
+            {
+                return true;
+            }
+            return false;
+        };
+        bool ok = expect(parses_to("rgb(300, -5, 50%)", {255, 0, 128}),
+                         "rgb components to be clamped", log);
+        ok = expect(parses_to(" RGB(1,2,3) ", {1, 2, 3}), "rgb to ignore case and spaces",
+                    log) && ok;
+        for (const char *text : {"rgb(nan,0,0)", "rgb(0,inf,0)", "rgb(0,0,-infinity)",
+                                 "rgb(1e999,0,0)", "rgb(nan%,0,0)", "rgb(0,0)"})
+        {
+            ok = expect(invalid(text), string(text) + " to be an invalid color", log) && ok;
+        }
+        return ok;
+    }
+
+    bool check_downscale(const string &root_path, ostream &log)
+    {
+        // Each output pixel must be the average of the source pixels it
+        // covers, weighted by the area they share, computed here in double
+        // precision: exactly rounded for integer factors (box filter), and
+        // within one level otherwise.
+        Document doc(root_path + "/input/gradient_1.svg");
+        int w = doc.width(), h = doc.height();
+        const pair<int, int> sizes[] = {
+            {w / 2, h / 2}, {w / 4, h / 4}, {w / 5, h / 5}, {w, h},   // Box
+            {w / 3, h / 3}, {w * 2 / 3, h / 2}, {37, 91}, {1, 1},     // Area
+        };
+        bool ok = true;
+        for (PixelFormat format : {PixelFormat::rgb, PixelFormat::rgbx, PixelFormat::rgba})
+        {
+            PNGImage img(w, h, format);
+            doc.draw(img);
+            for (const auto &size : sizes)
+            {
+                PNGImage out(size.first, size.second, format);
+                img.downscale(out);
+                double sx = (double)w / size.first, sy = (double)h / size.second;
+                bool box = w % size.first == 0 && sx == sy && h == size.second * (int)sx;
+                int worst = 0;
+                for (int oy = 0; oy < size.second; oy++)
+                {
+                    for (int ox = 0; ox < size.first; ox++)
+                    {
+                        double sum[3] = {0, 0, 0};
+                        for (int y = (int)(oy * sy); y < h && y < (oy + 1) * sy; y++)
+                        {
+                            double wy = min<double>(y + 1, (oy + 1) * sy) - max<double>(y, oy * sy);
+                            for (int x = (int)(ox * sx); x < w && x < (ox + 1) * sx; x++)
+                            {
+                                double wx =
+                                    min<double>(x + 1, (ox + 1) * sx) - max<double>(x, ox * sx);
+                                Color c = img.at(x, y);
+                                sum[0] += c.red * wx * wy;
+                                sum[1] += c.green * wx * wy;
+                                sum[2] += c.blue * wx * wy;
+                            }
+                        }
+                        Color c = out.at(ox, oy);
+                        int actual[3] = {c.red, c.green, c.blue};
+                        for (int k = 0; k < 3; k++)
+                        {
+                            int expected = (int)floor(sum[k] / (sx * sy) + 0.5);
+                            worst = max(worst, abs(actual[k] - expected));
+                        }
+                    }
+                }
+                ok = expect(worst <= (box ? 0 : 1),
+                            to_string(w) + "x" + to_string(h) + " to " + to_string(size.first) +
+                                "x" + to_string(size.second) + " in format " +
+                                to_string((int)format) + " to be within " + (box ? "0" : "1") +
+                                " of the average, got " + to_string(worst),
+                            log) && ok;
+            }
+        }
+        return ok;
+    }
+
+    bool check_translucent_coverage(const string &, ostream &log)
+    {
+        // A translucent polygon must cover the same pixels as an opaque
+        // one, each blended once.
+        const vector<vector<Point>> shapes = {
+            {{5, 5}, {15, 5}, {15, 15}, {5, 15}},
+            {{3, 17}, {10, 2}, {18, 14}},
+            {{2, 2}, {18, 2}, {18, 18}, {2, 18}, {2, 6}, {14, 6}, {14, 14}, {6, 14}, {6, 2}},
+        };
+        const Color red = {255, 0, 0};
+        bool ok = true;
+        for (size_t k = 0; k < shapes.size(); k++)
+        {
+            PNGImage opaque(20, 20), translucent(20, 20);
+            opaque.draw_polygon(shapes[k], red);
+            translucent.set_alpha(128);
+            translucent.draw_polygon(shapes[k], red);
+            int missed = 0, blended = 0;
+            for (int y = 0; y < 20; y++)
+            {
+                for (int x = 0; x < 20; x++)
+                {
+                    Color o = opaque.at(x, y), t = translucent.at(x, y);
+                    bool covered = o.green != 255;
+                    missed += covered != (t.green != 255);
+                    blended += covered && (t.red != 255 || t.green != 127 || t.blue != 127);
+                }
+            }
+            ok = expect(missed == 0 && blended == 0,
+                        "translucent shape " + to_string(k) + " to cover the opaque pixels once, " +
+                            to_string(missed) + " differ and " + to_string(blended) +
+                            " blend more than once",
+                        log) && ok;
+        }
+        return ok;
+    }
+
+    //! Checks, run with the golden tests. Their names start with "check_",
+    //! so that a spec selects them like test ids.
+    const map<string, Check> CHECKS = {
+        {"check_batch_errors", check_batch_errors},
+        {"check_colors", check_colors},
+        {"check_downscale", check_downscale},
+        {"check_cancel", check_cancel},
+        {"check_image_formats", check_image_formats},
+        {"check_limits", check_limits},
+        {"check_rebuild", check_rebuild},
+        {"check_rebuild_names", check_rebuild_names},
+        {"check_region_render", check_region_render},
+        {"check_scene_render", check_scene_render},
+        {"check_spatial_index", check_spatial_index},
+        {"check_svgz_size", check_svgz_size},
+        {"check_translucent_coverage", check_translucent_coverage},
+        {"check_use_expansion", check_use_expansion},
+    };
+
     class TestDriver
     {
     private:
@@ -32,52 +1049,109 @@ namespace svg
         int passed_tests = 0;
         int failed_tests = 0;
         FILE *log_stream;
+        //! Number of tests run at the same time.
+        unsigned jobs;
+        //! Run each test in its own process.
+        bool isolate;
+        //! Serializes reporting from concurrent tests.
+        mutex report_mutex;
+
+        //! Compares every pixel and writes a diff image: matching pixels
+        //! are a faded copy of the expected image, differing ones are red.
+        ImageDiff diff_images(const PNGImage &expected, const PNGImage &actual,
+                              const string &diff_file)
+        {
+            int w = expected.width(), h = expected.height();
+            ImageDiff d;
+            PNGImage diff(w, h);
+            for (int y = 0; y < h; y++)
+            {
+                const Color *e = expected.row(y), *a = actual.row(y);
+                for (int x = 0; x < w; x++)
+                {
+                    int delta = max(abs(e[x].red - a[x].red),
+                                    max(abs(e[x].green - a[x].green),
+                                        abs(e[x].blue - a[x].blue)));
+                    if (delta == 0)
+                    {
+                        int gray = (e[x].red + e[x].green + e[x].blue) / 3;
+                        rgb_value faded = (rgb_value)(192 + gray / 4);
+                        diff.at(x, y) = {faded, faded, faded};
+                        continue;
+                    }
+                    d.differing_pixels++;
+                    d.max_channel_delta = max(d.max_channel_delta, delta);
+                    d.total_channel_delta += delta;
+                    d.region = d.region.unite({x, y, x, y});
+                    diff.at(x, y) = {255, 0, 0};
+                }
+            }
+            diff.save(diff_file);
+            return d;
+        }
+
+        //! Runs a check, or a golden image test.
+        bool run_test(const string &id, ostream &log)
+        {
+            auto check = CHECKS.find(id);
+            if (check != CHECKS.end())
+            {
+                return check->second(root_path, log);
+            }
+            return run_conversion_test(id, log);
+        }
 
-        bool run_conversion_test(const string &id)
+        bool run_conversion_test(const string &id, ostream &log)
         {
             string svg_file = root_path + "/input/" + id + ".svg";
+            if (::access(svg_file.c_str(), F_OK) != 0)
+            {
+                svg_file += "z";
+            }
             string exp_file = root_path + "/expected/" + id + ".png";
             string out_file = root_path + "/output/" + id + ".png";
+            string diff_file = root_path + "/output/" + id + ".diff.png";
             convert(svg_file, out_file);
             PNGImage img1(exp_file), img2(out_file);
             int w1 = img1.width(), h1 = img1.height(),
                 w2 = img2.width(), h2 = img2.height();
             if (w1 != w2 || h1 != h2)
             {
-                std::cout << "Images have different dimensions: "
-                          << w1 << "x" << h1 << " != "
-                          << w2 << "x" << h2 << endl;
+                log << "Images have different dimensions: "
+                    << w1 << "x" << h1 << " != "
+                    << w2 << "x" << h2 << endl;
                 return false;
             }
-            for (int i = 0; i < w1; i++)
+            // Fast path: identical rows compare with memcmp.
+            int y = 0;
+            while (y < h1 && ::memcmp(img1.row(y), img2.row(y), w1 * sizeof(Color)) == 0)
             {
-                for (int j = 0; j < h1; j++)
-                {
-                    Color c1 = img1.at(i, j), c2 = img2.at(i, j);
-                    if (c1.red != c2.red || c1.green != c2.green || c1.blue != c2.blue)
-                    {
-                        cout << "pixel (" << i << ' ' << j << "): expected "
-                             << (int)c1.red << ' ' << (int)c1.green << ' ' << (int)c1.blue
-                             << " got "
-                             << (int)c2.red << ' ' << (int)c2.green << ' ' << (int)c2.blue << std::endl;
-                        return false;
-                    }
-                }
+                y++;
             }
-            return true;
+            if (y == h1)
+            {
+                ::remove(diff_file.c_str());
+                return true;
+            }
+            ImageDiff d = diff_images(img1, img2, diff_file);
+            log << d.differing_pixels << " of " << w1 * h1 << " pixels differ ("
+                << fixed << setprecision(2) << 100.0 * d.differing_pixels / (w1 * h1)
+                << "%) in region (" << d.region.x_min << ' ' << d.region.y_min
+                << ")-(" << d.region.x_max << ' ' << d.region.y_max << ")" << endl
+                << "max channel delta " << d.max_channel_delta
+                << ", mean channel delta "
+                << (double)d.total_channel_delta / d.differing_pixels << endl
+                << "diff image: " << diff_file << endl;
+            return false;
         }
 
-        void onTestBegin(const string &id)
+        void onTestCompletion(int number, const string &id, bool success, const string &log)
         {
-            total_tests++;
-            fprintf(log_stream, ">>>> [%d] %s <<<<\n", total_tests, id.c_str());
+            lock_guard<mutex> lock(report_mutex);
+            fprintf(log_stream, ">>>> [%d] %s <<<<\n%s", number, id.c_str(), log.c_str());
             fflush(log_stream);
-            cout << '[' << total_tests << "] " << id << ": ";
-            cout.flush();
-        }
-        void onTestCompletion(bool success)
-        {
-            cout << (success ? "pass" : "fail") << std::endl;
+            cout << '[' << number << "] " << id << ": "
+                 << (success ? "pass" : "fail") << std::endl;
             if (success)
             {
                 passed_tests++;
@@ -88,42 +1162,126 @@ namespace svg
             }
         }
 
-        void run_test(const string& id)
+        //! Runs tests in child processes, at most `jobs` at a time. Each
+        //! child writes its output to a private temporary file, which is
+        //! copied to the log when the child finishes.
+        void run_isolated(const vector<string> &ids)
         {
-            int log_fd = ::fileno(log_stream);
-            onTestBegin(id);
-            ::pid_t pid = ::fork();
-
-            if (pid == 0)
+            struct Child
             {
-            
-                ::dup2(log_fd, 1);
-                ::dup2(log_fd, 2);
-                bool success = run_conversion_test(id);
-                ::exit(success ? 0 : 1);
-            }
-            else if (pid > 0)
+                int number;
+                string id;
+                FILE *output;
+            };
+            map<::pid_t, Child> running;
+            size_t next = 0;
+            while (next < ids.size() || !running.empty())
             {
-                // parent process waits
+                while (next < ids.size() && running.size() < jobs)
+                {
+                    FILE *output = ::tmpfile();
+                    if (output == nullptr)
+                    {
+                        perror("Unable to run tests! Temporary file creation failed!");
+                        ::exit(1);
+                    }
+                    cout.flush();
+                    ::pid_t pid = ::fork();
+                    if (pid == 0)
+                    {
+                        ::dup2(::fileno(output), 1);
+                        ::dup2(::fileno(output), 2);
+                        ostringstream log;
+                        bool success = run_test(ids[next], log);
+                        cout << log.str();
+                        cout.flush();
+                        ::exit(success ? 0 : 1);
+                    }
+                    else if (pid < 0)
+                    {
+                        perror("Unable to run tests! Process creation failed!");
+                        ::exit(1);
+                    }
+                    total_tests++;
+                    running[pid] = {total_tests, ids[next], output};
+                    next++;
+                }
+                // wait for any child
                 int child_status = -1;
-                ::waitpid(pid, &child_status, 0);
-
+                ::pid_t pid = ::waitpid(-1, &child_status, 0);
+                if (pid < 0)
+                {
+                    perror("Unable to run tests! Waiting for a test failed!");
+                    ::exit(1);
+                }
+                auto it = running.find(pid);
+                if (it == running.end())
+                {
+                    continue;
+                }
                 bool success = WIFEXITED(child_status) &&
                                WEXITSTATUS(child_status) == 0;
-                onTestCompletion(success);
+                string log;
+                ::rewind(it->second.output);
+                char buf[4096];
+                size_t n;
+                while ((n = ::fread(buf, 1, sizeof(buf), it->second.output)) > 0)
+                {
+                    log.append(buf, n);
+                }
+                ::fclose(it->second.output);
+                if (!WIFEXITED(child_status))
+                {
+                    log += "test process terminated abnormally\n";
+                }
+                onTestCompletion(it->second.number, it->second.id, success, log);
+                running.erase(it);
             }
-            else
+        }
+
+        //! Runs tests on `jobs` threads of this process. Faster, but a
+        //! crashing test takes the whole run down.
+        void run_in_process(const vector<string> &ids)
+        {
+            atomic<size_t> next(0);
+            auto worker = [&]()
+            {
+                size_t i;
+                while ((i = next++) < ids.size())
+                {
+                    ostringstream log;
+                    bool success;
+                    try
+                    {
+                        success = run_test(ids[i], log);
+                    }
+                    catch (const exception &e)
+                    {
+                        log << "exception: " << e.what() << endl;
+                        success = false;
+                    }
+                    onTestCompletion((int)i + 1, ids[i], success, log.str());
+                }
+            };
+            vector<thread> threads;
+            for (unsigned t = 1; t < jobs; t++)
+            {
+                threads.push_back(thread(worker));
+            }
+            worker();
+            for (thread &t : threads)
             {
-                // pid < 0
-                perror("Unable to run tests! Process creation failed!");
-                ::exit(1);
+                t.join();
             }
+            total_tests += ids.size();
         }
 
     public:
-        TestDriver(const string &root_path)
+        TestDriver(const string &root_path, unsigned jobs, bool isolate)
             : root_path(root_path),
-              log_stream(fopen((root_path + "/" + LOG_FILE_NAME).c_str(), "w"))
+              log_stream(fopen((root_path + "/" + LOG_FILE_NAME).c_str(), "w")),
+              jobs(max(1u, jobs)),
+              isolate(isolate)
         {
         }
 
@@ -150,6 +1308,13 @@ namespace svg
                 }
             }
             ::closedir(directory);
+            for (const auto &check : CHECKS)
+            {
+                if (check.first.find(spec) == 0)
+                {
+                    scripts_to_execute.push_back(check.first);
+                }
+            }
             if (scripts_to_execute.empty())
             {
                 cout << "No scripts matched the spec: " << spec << endl;
@@ -157,10 +1322,17 @@ namespace svg
             }
             sort(scripts_to_execute.begin(), scripts_to_execute.end());
 
-            cout << "== " << scripts_to_execute.size() << " tests to execute  ==" << endl;
-            for (string id : scripts_to_execute)
+            cout << "== " << scripts_to_execute.size() << " tests to execute ("
+                 << jobs << (jobs == 1 ? " job" : " jobs")
+                 << (isolate ? ", one process per test" : ", in process")
+                 << ") ==" << endl;
+            if (isolate)
             {
-                run_test(id);
+                run_isolated(scripts_to_execute);
+            }
+            else
+            {
+                run_in_process(scripts_to_execute);
             }
 
             cout << "== TEST EXECUTION SUMMARY ==" << endl
@@ -174,10 +1346,27 @@ namespace svg
 
 int main(int argc, char **argv)
 {
-    --argc;
-    ++argv;
-    svg::TestDriver driver(argc == 2 ? argv[1] : ".");
-    string spec = argc >= 1 ? argv[0] : "";
+    unsigned jobs = std::thread::hardware_concurrency();
+    bool isolate = true;
+    vector<string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc)
+        {
+            jobs = (unsigned)atoi(argv[++i]);
+        }
+        else if (arg == "--in-process")
+        {
+            isolate = false;
+        }
+        else
+        {
+            args.push_back(arg);
+        }
+    }
+    svg::TestDriver driver(args.size() == 2 ? args[1] : ".", jobs, isolate);
+    string spec = args.size() >= 1 ? args[0] : "";
     driver.run_tests(spec);
 
     return 0;